@@ -0,0 +1,301 @@
+// Decode time benchmarks for the images in data/, run from the build directory:
+//     ./image_bench [iterations]
+// The synthetic images are written to the working directory and removed afterwards.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "stb_image_aug.h"
+
+#define resource(name) DATA#name
+
+namespace {
+
+    const char *const SIMD_NAMES[] = {"scalar", "sse2", "avx2"};
+
+    double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // best and average milliseconds of a few runs, returns the best in seconds
+    double measure(const std::string &label, int iterations, const std::function<void()> &run)
+    {
+        double best = 1e9, total = 0.0;
+        for (int i = 0; i < iterations; i++) {
+            double start = now();
+            run();
+            double elapsed = now() - start;
+            best = std::min(best, elapsed);
+            total += elapsed;
+        }
+        std::cout << "  " << label << ": best " << best * 1000.0 << " ms, avg " << total / iterations * 1000.0
+                  << " ms" << std::endl;
+        return best;
+    }
+
+    // stands in for the idct so a decode shows what everything around it costs
+    void skipIDCT(stbi_uc *, int, short *, unsigned short *)
+    {
+    }
+
+    bool readFile(const char *path, std::vector<unsigned char> &data)
+    {
+        std::ifstream file(path, std::ios_base::binary);
+        if (!file)
+            return false;
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // a DRI marker, the entropy decode only splits over threads with restart intervals
+    bool hasRestartIntervals(const std::vector<unsigned char> &file)
+    {
+        for (size_t i = 0; i + 1 < file.size(); i++) {
+            if (file[i] == 0xff && file[i + 1] == 0xdd)
+                return true;
+            if (file[i] == 0xff && file[i + 1] == 0xda)
+                break;
+        }
+        return false;
+    }
+
+    // decodes a jpeg already in memory on one thread with the built-in kernels of every level the
+    // cpu runs, the scalar one is the decoder before the simd kernels and the reference the others
+    // must match, then on more threads with the widest kernels
+    void benchJPEG(const char *name, const char *path, int iterations)
+    {
+        std::vector<unsigned char> file;
+        if (!readFile(path, file)) {
+            std::cerr << "can't read " << path << std::endl;
+            return;
+        }
+
+        int width = 0, height = 0, components = 0;
+        stbi_set_thread_count(1);
+        stbi_simd_install(STBI_simd_scalar);
+        unsigned char *reference = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height,
+                                                         &components, 4);
+        if (!reference) {
+            std::cerr << "can't decode " << path << ": " << stbi_failure_reason() << std::endl;
+            return;
+        }
+        std::cout << name << ", " << width << "x" << height << ", " << file.size() / 1024 << " KB, "
+                  << (hasRestartIntervals(file) ? "restart intervals" : "no restart intervals") << ", best of "
+                  << iterations << ", cpu supports " << SIMD_NAMES[stbi_simd_support()] << std::endl;
+
+        for (int level = STBI_simd_scalar; level <= stbi_simd_support(); level++) {
+            stbi_simd_install(level);
+            unsigned char *pixels = NULL;
+            double seconds = measure(SIMD_NAMES[level], iterations, [&]() {
+                stbi_image_free(pixels);
+                pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height,
+                                               &components, 4);
+            });
+            std::cout << "    " << width * height / seconds / 1e6 << " Mpixels/s" << std::endl;
+            if (!pixels || memcmp(pixels, reference, width * height * 4) != 0)
+                std::cout << "    differs from the scalar decode" << std::endl;
+            stbi_image_free(pixels);
+        }
+        stbi_install_idct(skipIDCT);
+        unsigned char *pixels = NULL;
+        measure("without the idct", iterations, [&]() {
+            stbi_image_free(pixels);
+            pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &components, 4);
+        });
+        stbi_image_free(pixels);
+        stbi_simd_install(stbi_simd_support());
+
+        stbi_set_thread_count(0);
+        std::vector<int> threadCounts;
+        for (int threads = 2; threads < stbi_thread_count(); threads *= 2)
+            threadCounts.push_back(threads);
+        if (stbi_thread_count() > 1)
+            threadCounts.push_back(stbi_thread_count());
+        for (int threads : threadCounts) {
+            stbi_set_thread_count(threads);
+            pixels = NULL;
+            double seconds = measure(std::to_string(threads) + " threads", iterations, [&]() {
+                stbi_image_free(pixels);
+                pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height,
+                                               &components, 4);
+            });
+            std::cout << "    " << width * height / seconds / 1e6 << " Mpixels/s" << std::endl;
+            if (!pixels || memcmp(pixels, reference, width * height * 4) != 0)
+                std::cout << "    differs from the scalar decode" << std::endl;
+            stbi_image_free(pixels);
+        }
+        stbi_set_thread_count(0);
+        stbi_image_free(reference);
+    }
+
+    // averages every scale x scale block, the edge blocks over the pixels they have
+    std::vector<unsigned char> boxReduce(const unsigned char *pixels, int width, int height, int components, int scale,
+                                         int &outWidth, int &outHeight)
+    {
+        outWidth = (width + scale - 1) / scale;
+        outHeight = (height + scale - 1) / scale;
+        std::vector<unsigned char> out(static_cast<size_t>(outWidth) * outHeight * components);
+        for (int y = 0; y < outHeight; y++) {
+            int y1 = std::min(height, (y + 1) * scale);
+            for (int x = 0; x < outWidth; x++) {
+                int x1 = std::min(width, (x + 1) * scale);
+                int count = (x1 - x * scale) * (y1 - y * scale);
+                for (int c = 0; c < components; c++) {
+                    int sum = count / 2;
+                    for (int v = y * scale; v < y1; v++)
+                        for (int u = x * scale; u < x1; u++)
+                            sum += pixels[(static_cast<size_t>(v) * width + u) * components + c];
+                    out[(static_cast<size_t>(y) * outWidth + x) * components + c] =
+                        static_cast<unsigned char>(sum / count);
+                }
+            }
+        }
+        return out;
+    }
+
+    // a jpeg decoded at 1/2, 1/4 and 1/8 of its size with the reduced idcts, against decoding it
+    // whole and box filtering it down, with how far the two are apart
+    void benchScaledJPEG(const char *name, const char *path, int iterations)
+    {
+        std::vector<unsigned char> file;
+        if (!readFile(path, file)) {
+            std::cerr << "can't read " << path << std::endl;
+            return;
+        }
+        std::cout << name << " scaled, best of " << iterations << std::endl;
+        for (int scale = 2; scale <= 8; scale *= 2) {
+            int width = 0, height = 0, components = 0, boxWidth = 0, boxHeight = 0;
+            std::vector<unsigned char> box;
+            measure("1/" + std::to_string(scale) + " full decode and box filter", iterations, [&]() {
+                unsigned char *full = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width,
+                                                            &height, &components, 4);
+                if (full)
+                    box = boxReduce(full, width, height, 4, scale, boxWidth, boxHeight);
+                stbi_image_free(full);
+            });
+            unsigned char *pixels = NULL;
+            measure("1/" + std::to_string(scale) + " idct", iterations, [&]() {
+                stbi_image_free(pixels);
+                pixels = stbi_load_from_memory_scaled(file.data(), static_cast<int>(file.size()), &width, &height,
+                                                      &components, 4, scale);
+            });
+            if (!pixels || width != boxWidth || height != boxHeight) {
+                std::cout << "    can't decode at 1/" << scale << std::endl;
+            } else {
+                int worst = 0;
+                double total = 0.0;
+                for (size_t i = 0; i < box.size(); i++) {
+                    int error = std::abs(pixels[i] - box[i]);
+                    worst = std::max(worst, error);
+                    total += error;
+                }
+                std::cout << "    " << width << "x" << height << ", mean error " << total / box.size()
+                          << ", max error " << worst << std::endl;
+            }
+            stbi_image_free(pixels);
+        }
+    }
+
+    unsigned char *loadFromStdio(const char *path, int &width, int &height, int &components)
+    {
+        FILE *file = fopen(path, "rb");
+        if (!file)
+            return NULL;
+        unsigned char *pixels = stbi_load_from_file(file, &width, &height, &components, 0);
+        fclose(file);
+        return pixels;
+    }
+
+    // the decoders reading an open stdio file, a call for every byte, against loading the path,
+    // which maps the file and decodes it from memory
+    void benchFileSource(const std::string &label, const std::vector<std::string> &paths, int iterations)
+    {
+        std::cout << label << ", best of " << iterations << std::endl;
+        std::vector<unsigned char *> reference(paths.size(), NULL), pixels(paths.size(), NULL);
+        std::vector<size_t> sizes(paths.size(), 0);
+        auto run = [&](std::vector<unsigned char *> &images, bool stdio) {
+            for (size_t i = 0; i < paths.size(); i++) {
+                int width = 0, height = 0, components = 0;
+                stbi_image_free(images[i]);
+                images[i] = stdio ? loadFromStdio(paths[i].c_str(), width, height, components)
+                                  : stbi_load(paths[i].c_str(), &width, &height, &components, 0);
+                sizes[i] = static_cast<size_t>(width) * height * components;
+            }
+        };
+        measure("stdio FILE", iterations, [&]() { run(reference, true); });
+        measure("stbi_load, mapped", iterations, [&]() { run(pixels, false); });
+
+        for (size_t i = 0; i < paths.size(); i++) {
+            if (!reference[i] || !pixels[i] || memcmp(reference[i], pixels[i], sizes[i]) != 0)
+                std::cout << "    " << paths[i] << " differs from the stdio decode" << std::endl;
+            stbi_image_free(reference[i]);
+            stbi_image_free(pixels[i]);
+        }
+    }
+
+    // count uncompressed side x side images, bmp and tga, rgb and rgba, each a different pattern
+    std::vector<std::string> writeCorpus(int side, int count)
+    {
+        std::vector<std::string> paths;
+        std::vector<unsigned char> pixels(static_cast<size_t>(side) * side * 4);
+        for (int k = 0; k < count; k++) {
+            for (size_t i = 0; i < pixels.size(); i++)
+                pixels[i] = static_cast<unsigned char>(i * (k + 3) / 7 + (i / (side * 4)) * k);
+            std::string path = "image_bench_" + std::to_string(side) + "_" + std::to_string(k) +
+                               (k % 2 ? ".tga" : ".bmp");
+            int components = k % 4 < 2 ? 3 : 4;
+            int written = k % 2 ? stbi_write_tga(path.c_str(), side, side, components, pixels.data())
+                                : stbi_write_bmp(path.c_str(), side, side, components, pixels.data());
+            if (!written) {
+                std::cerr << "can't write " << path << std::endl;
+                break;
+            }
+            paths.push_back(path);
+        }
+        return paths;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 5;
+    if (iterations < 1)
+        iterations = 1;
+
+    benchJPEG("front.jpg", resource(front.jpg), iterations);
+    benchJPEG("back.jpg", resource(back.jpg), iterations);
+    benchJPEG("left.jpg", resource(left.jpg), iterations);
+    benchJPEG("right.jpg", resource(right.jpg), iterations);
+    benchJPEG("top.jpg", resource(top.jpg), iterations);
+    benchJPEG("bottom.jpg", resource(bottom.jpg), iterations);
+    benchJPEG("wall.jpg", resource(wall.jpg), iterations);
+    benchScaledJPEG("front.jpg", resource(front.jpg), iterations);
+    benchScaledJPEG("wall.jpg", resource(wall.jpg), iterations);
+
+    // every image in data/ stb_image reads, red.pcx is the md2 skin and has its own loader
+    const char *const images[] = {resource(front.jpg), resource(back.jpg), resource(left.jpg), resource(right.jpg),
+                                  resource(top.jpg), resource(bottom.jpg), resource(wall.jpg), resource(floor.png)};
+    for (const char *image : images)
+        benchFileSource(image, std::vector<std::string>(1, image), iterations);
+
+    const int sides[] = {32, 256, 1024, 2048};
+    const int counts[] = {512, 64, 8, 2};
+    for (int i = 0; i < 4; i++) {
+        std::vector<std::string> corpus = writeCorpus(sides[i], counts[i]);
+        benchFileSource("synthetic " + std::to_string(corpus.size()) + " bmp and tga, " + std::to_string(sides[i]) +
+                        "x" + std::to_string(sides[i]), corpus, iterations);
+        for (const std::string &path : corpus)
+            std::remove(path.c_str());
+    }
+    return 0;
+}
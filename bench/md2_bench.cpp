@@ -0,0 +1,510 @@
+// Load time benchmarks for the md2 loader, run from the build directory:
+//     ./md2_bench [iterations]
+// Synthetic models and the bake caches are written next to the models and removed afterwards.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "md2_model.h"
+#include "md2_batch.h"
+#include "md2_dequantize.h"
+#include "animation.h"
+#include "compressed_animation.h"
+
+#define resource(name) DATA#name
+
+namespace {
+
+    // heap allocations made since the start, counted by the operator new below, atomic for the
+    // batch loader threads
+    std::atomic<size_t> allocations(0);
+}
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+    double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // best and average milliseconds of a few runs and the heap allocations of one, returns the best
+    // in seconds
+    double measure(const std::string &label, int iterations, const std::function<void()> &run)
+    {
+        double best = 1e9, total = 0.0;
+        size_t allocated = allocations;
+        for (int i = 0; i < iterations; i++) {
+            double start = now();
+            run();
+            double elapsed = now() - start;
+            best = std::min(best, elapsed);
+            total += elapsed;
+        }
+        std::cout << "  " << label << ": best " << best * 1000.0 << " ms, avg " << total / iterations * 1000.0
+                  << " ms, " << (allocations - allocated) / iterations << " allocations" << std::endl;
+        return best;
+    }
+
+    // the loader main() had before the md2 module, one ifstream read per vertex and the triangle
+    // table read again for every frame
+    bool legacyLoad(const char *path, std::vector<std::vector<Vertex>> &frameVertices)
+    {
+        std::ifstream md2File(path, std::ios_base::binary);
+        if (!md2File)
+            return false;
+
+        MD2 md2;
+        md2File.read(reinterpret_cast<char *>(&md2), sizeof(md2));
+
+        std::vector<Frame> frames;
+        std::vector<std::vector<TriangleVertex>> triangleVertices;
+        std::vector<MeshUV> uvs;
+        std::vector<Vertex> vertices;
+        std::vector<VertexUV> sts;
+
+        md2File.seekg(md2.offsetFrames, md2File.beg);
+        for (int i = 0; i < md2.numFrames; i++) {
+            Frame frame;
+            md2File.read(reinterpret_cast<char *>(&frame), sizeof(frame));
+            frames.push_back(frame);
+
+            std::vector<TriangleVertex> vertices;
+            vertices.push_back(frame.vertices[0]);
+            for (int i = 1; i < md2.numVertices; i++) {
+                TriangleVertex triangleVertex;
+                md2File.read(reinterpret_cast<char *>(&triangleVertex), sizeof(triangleVertex));
+                vertices.push_back(triangleVertex);
+            }
+            triangleVertices.push_back(vertices);
+        }
+
+        md2File.seekg(md2.offsetTexCoords, md2File.beg);
+        for (int i = 0; i < md2.numTexCoords; i++) {
+            MeshUV meshUV;
+            md2File.read(reinterpret_cast<char *>(&meshUV), sizeof(meshUV));
+            uvs.push_back(meshUV);
+        }
+
+        for (size_t p = 0; p < frames.size(); p++) {
+            for (size_t i = 0; i < triangleVertices[p].size(); i++) {
+                Vertex vertex;
+                vertex.coords[0] = triangleVertices[p][i].vertex[0] * frames[p].scale[0] + frames[p].translate[0];
+                vertex.coords[1] = triangleVertices[p][i].vertex[2] * frames[p].scale[2] + frames[p].translate[2];
+                vertex.coords[2] = triangleVertices[p][i].vertex[1] * frames[p].scale[1] + frames[p].translate[1];
+                vertices.push_back(vertex);
+            }
+
+            std::vector<Vertex> frameVertex;
+            md2File.seekg(md2.offsetTriangles, md2File.beg);
+            for (int i = 0; i < md2.numTriangles; i++) {
+                Mesh mesh;
+                md2File.read(reinterpret_cast<char *>(&mesh), sizeof(mesh));
+                for (size_t k = 0; k < 3; k++) {
+                    frameVertex.push_back(vertices[mesh.meshIndex[k]]);
+
+                    VertexUV uv;
+                    uv.st[0] = uvs[mesh.stIndex[k]].s / (float) md2.skinWidth;
+                    uv.st[1] = uvs[mesh.stIndex[k]].t / (float) md2.skinWidth;
+                    sts.push_back(uv);
+                }
+            }
+            vertices.clear();
+            frameVertices.push_back(frameVertex);
+        }
+        return true;
+    }
+
+    template <typename T>
+    void append(std::vector<char> &data, const T &record)
+    {
+        const char *bytes = reinterpret_cast<const char *>(&record);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    // a side x side vertex grid folded into triangles, every frame moves the vertices a bit
+    std::vector<char> syntheticMD2(int side, int numFrames)
+    {
+        int numVertices = side * side;
+        int numTriangles = (side - 1) * (side - 1) * 2;
+        int frameSize = offsetof(Frame, vertices) + numVertices * sizeof(TriangleVertex);
+
+        MD2 md2;
+        memset(&md2, 0, sizeof(md2));
+        memcpy(&md2.magic, "IDP2", 4);
+        md2.version = 8;
+        md2.skinWidth = 256;
+        md2.skinHeight = 256;
+        md2.frameSize = frameSize;
+        md2.numVertices = numVertices;
+        md2.numTexCoords = numVertices;
+        md2.numTriangles = numTriangles;
+        md2.numGlCommands = 1;
+        md2.numFrames = numFrames;
+        md2.offsetTexCoords = sizeof(MD2);
+        md2.offsetTriangles = md2.offsetTexCoords + numVertices * sizeof(MeshUV);
+        md2.offsetFrames = md2.offsetTriangles + numTriangles * sizeof(Mesh);
+        md2.offsetGlCommands = md2.offsetFrames + numFrames * frameSize;
+        md2.offsetEnd = md2.offsetGlCommands + sizeof(int);
+        md2.offsetSkins = md2.offsetEnd;
+
+        std::vector<char> data;
+        append(data, md2);
+        for (int i = 0; i < numVertices; i++) {
+            MeshUV uv = {static_cast<unsigned short>(i % side * 255 / side),
+                         static_cast<unsigned short>(i / side * 255 / side)};
+            append(data, uv);
+        }
+        for (int y = 0; y + 1 < side; y++) {
+            for (int x = 0; x + 1 < side; x++) {
+                unsigned short v = y * side + x;
+                Mesh a = {{v, static_cast<unsigned short>(v + 1), static_cast<unsigned short>(v + side)},
+                          {v, static_cast<unsigned short>(v + 1), static_cast<unsigned short>(v + side)}};
+                Mesh b = {{static_cast<unsigned short>(v + 1), static_cast<unsigned short>(v + side + 1),
+                           static_cast<unsigned short>(v + side)},
+                          {static_cast<unsigned short>(v + 1), static_cast<unsigned short>(v + side + 1),
+                           static_cast<unsigned short>(v + side)}};
+                append(data, a);
+                append(data, b);
+            }
+        }
+        for (int f = 0; f < numFrames; f++) {
+            float header[6] = {0.1f, 0.1f, 0.1f, -12.8f, -12.8f, -12.8f};
+            data.insert(data.end(), reinterpret_cast<char *>(header), reinterpret_cast<char *>(header) + sizeof(header));
+            char name[16];
+            memset(name, 0, sizeof(name));
+            snprintf(name, sizeof(name), "synth%03d", f);
+            data.insert(data.end(), name, name + sizeof(name));
+            for (int i = 0; i < numVertices; i++) {
+                TriangleVertex v = {{static_cast<unsigned char>(i % side * 255 / side),
+                                     static_cast<unsigned char>(i / side * 255 / side),
+                                     static_cast<unsigned char>((i + f) % 256)}, 0};
+                append(data, v);
+            }
+        }
+        append(data, 0);
+        return data;
+    }
+
+    // decodes every md2 vertex of every frame, without the mesh build in between
+    void decodeAll(MD2Model &model)
+    {
+        model.weldedVertices.resize(model.view.vertexCount());
+        for (size_t i = 0; i < model.weldedVertices.size(); i++)
+            model.weldedVertices[i] = i;
+        decodeFrames(model);
+    }
+
+    void benchLoad(const std::string &label, const char *path, int iterations)
+    {
+        std::cout << label << std::endl;
+        measure("legacy ifstream loader", iterations, [&]() {
+            std::vector<std::vector<Vertex>> frameVertices;
+            legacyLoad(path, frameVertices);
+        });
+        measure("bulk read + parse + decode", iterations, [&]() {
+            MD2Model model;
+            std::vector<char> data;
+            readFile(path, data);
+            parseMD2(data.data(), data.size(), model);
+            decodeAll(model);
+        });
+        measure("map + parse + decode", iterations, [&]() {
+            MD2Model model;
+            model.file.open(path);
+            parseMD2(model.file.data(), model.file.size(), model);
+            decodeAll(model);
+        });
+        measure("map + parse, no frame touched", iterations, [&]() {
+            MD2Model model;
+            model.file.open(path);
+            parseMD2(model.file.data(), model.file.size(), model);
+        });
+        {
+            MD2Model model;
+            model.file.open(path);
+            parseMD2(model.file.data(), model.file.size(), model);
+            buildMesh(model, false);
+            decodeFrames(model);
+            measure("level of detail chain", iterations, [&]() { simplifyMesh(model); });
+            std::cout << "    triangles " << model.indices.size() / 3;
+            for (int level = 0; level < LOD_LEVELS; level++)
+                std::cout << " / " << model.lodIndices[level].size() / 3;
+            std::cout << std::endl;
+        }
+        measure("loadMD2 with mesh build, no cache", iterations, [&]() {
+            MD2Model model;
+            loadMD2(path, model, false, false);
+        });
+        std::string bakePath = std::string(path) + ".bake";
+        measure("loadMD2 building and writing the bake", iterations, [&]() {
+            std::remove(bakePath.c_str());
+            MD2Model model;
+            loadMD2(path, model);
+        });
+        measure("loadMD2 from the bake", iterations, [&]() {
+            MD2Model model;
+            loadMD2(path, model);
+        });
+        measure("loadMD2 from the bake, every stream touched", iterations, [&]() {
+            MD2Model model;
+            loadMD2(path, model);
+            const BakedMD2 &baked = model.baked;
+            std::vector<char> upload(baked.header().fileSize);
+            memcpy(upload.data(), baked.frames().data(), baked.frames().size() * sizeof(Vertex));
+            memcpy(upload.data(), baked.quantizedFrames().data(),
+                   baked.quantizedFrames().size() * sizeof(TriangleVertex));
+            memcpy(upload.data(), baked.normals().data(), baked.normals().size() * sizeof(GLuint));
+            memcpy(upload.data(), baked.sts(), baked.vertexCount() * sizeof(VertexUV));
+            memcpy(upload.data(), baked.indices(), baked.indexCount() * sizeof(GLushort));
+        });
+        std::remove(bakePath.c_str());
+    }
+
+    // a level worth of models of mixed sizes loaded one after the other and on worker threads, the
+    // upload copies the streams like glBufferData would on the context thread
+    void benchBatch(int count, int iterations)
+    {
+        std::vector<std::string> paths;
+        size_t bytes = 0;
+        const int sides[] = {12, 16, 24, 32};
+        for (int i = 0; i < count; i++) {
+            char path[64];
+            snprintf(path, sizeof(path), "md2_bench_batch%03d.md2", i);
+            std::vector<char> data = syntheticMD2(sides[i % 4], 100 + i % 7 * 20);
+            if (!writeFile(path, data)) {
+                std::cerr << "can't write " << path << std::endl;
+                return;
+            }
+            paths.push_back(path);
+            bytes += data.size();
+        }
+        std::cout << "batch of " << count << " models, " << bytes / 1024 << " KB, "
+                  << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+
+        std::vector<char> upload;
+        auto copyStreams = [&](size_t, MD2Model &model) {
+            const BakedMD2 &baked = model.baked;
+            upload.resize(std::max<size_t>(upload.size(), baked.header().fileSize));
+            memcpy(upload.data(), baked.quantizedFrames().data(),
+                   baked.quantizedFrames().size() * sizeof(TriangleVertex));
+            memcpy(upload.data(), baked.normals().data(), baked.normals().size() * sizeof(GLuint));
+            memcpy(upload.data(), baked.sts(), baked.vertexCount() * sizeof(VertexUV));
+            memcpy(upload.data(), baked.indices(), baked.indexCount() * sizeof(GLushort));
+        };
+
+        const bool caches[] = {false, true};
+        for (bool useCache : caches) {
+            std::string source = useCache ? "from the bakes" : "with mesh builds, no cache";
+            if (useCache) {
+                std::vector<MD2Model> models;
+                loadMD2Batch(paths, models);
+            }
+            // the models are kept like a level load would
+            measure("sequential loadMD2 " + source, iterations, [&]() {
+                std::unique_ptr<MD2Model[]> models(new MD2Model[paths.size()]);
+                for (size_t i = 0; i < paths.size(); i++) {
+                    if (loadMD2(paths[i].c_str(), models[i], false, useCache))
+                        copyStreams(i, models[i]);
+                }
+            });
+            const unsigned int threadCounts[] = {1, 2, 4, 0};
+            for (unsigned int threads : threadCounts) {
+                measure("loadMD2Batch " + source + ", " + (threads ? std::to_string(threads) : "all") + " threads",
+                        iterations, [&]() {
+                    std::vector<MD2Model> models;
+                    loadMD2Batch(paths, models, copyStreams, threads, false, useCache);
+                });
+            }
+        }
+
+        for (const std::string &path : paths) {
+            std::remove(path.c_str());
+            std::remove((path + ".bake").c_str());
+        }
+    }
+
+    // one animation tick of a crowd playing every clip of the model
+    void benchAnimation(const char *path, int iterations)
+    {
+        MD2Model model;
+        loadMD2(path, model);
+        std::vector<AnimationClip> clips = buildClips(model.view, 10.0f);
+        std::cout << "animation update, " << clips.size() << " clips" << std::endl;
+        const int counts[] = {1000, 10000, 100000};
+        for (int count : counts) {
+            AnimationPlayer player;
+            for (int i = 0; i < count; i++)
+                player.add(clips[i % clips.size()], i * 0.37f);
+            measure(std::to_string(count) + " instances", iterations * 20, [&]() {
+                player.update(1.0f / 60.0f, true);
+            });
+        }
+        std::remove((std::string(path) + ".bake").c_str());
+    }
+
+    // every frame of a model dequantized at each instruction set level, in file order and through
+    // the welded vertices like decodeFrames, against copying the float positions
+    void benchDequantize(const std::string &label, const char *path, int iterations)
+    {
+        MD2Model model;
+        if (!model.file.open(path) || !parseMD2(model.file.data(), model.file.size(), model))
+            return;
+        buildMesh(model, false);
+        const MD2View &view = model.view;
+        size_t vertexCount = view.vertexCount();
+        size_t weldedCount = model.weldedVertices.size();
+        std::vector<Vertex> reference(view.frameCount() * std::max(vertexCount, weldedCount));
+        std::vector<Vertex> vertices(reference.size());
+
+        std::cout << label << " dequantize, " << view.frameCount() << " frames, best of " << iterations
+                  << ", cpu supports " << dequantizeName(dequantizeSupport()) << std::endl;
+        auto report = [&](double seconds, size_t bytes) {
+            std::cout << "    " << bytes / seconds / (1024.0 * 1024.0) << " MB/s read + written" << std::endl;
+        };
+        size_t frameBytes = view.frameCount() * vertexCount * sizeof(Vertex);
+        double seconds = measure("memcpy of the float positions", iterations, [&]() {
+            memcpy(vertices.data(), reference.data(), frameBytes);
+        });
+        report(seconds, 2 * frameBytes);
+
+        for (int indexed = 0; indexed < 2; indexed++) {
+            const unsigned short *indices = indexed ? model.weldedVertices.data() : NULL;
+            size_t count = indexed ? weldedCount : vertexCount;
+            for (int f = 0; f < view.frameCount(); f++)
+                dequantizeFrame(*view.frame(f), view.frameVertices(f), indices, count, &reference[f * count],
+                                DEQUANTIZE_SCALAR);
+            for (int level = DEQUANTIZE_SCALAR; level <= dequantizeSupport(); level++) {
+                DequantizeLevel dequantizeLevel = static_cast<DequantizeLevel>(level);
+                std::string name = std::string(dequantizeName(dequantizeLevel)) +
+                                   (indexed ? ", welded vertices" : ", file order");
+                seconds = measure(name, iterations, [&]() {
+                    for (int f = 0; f < view.frameCount(); f++) {
+                        dequantizeFrame(*view.frame(f), view.frameVertices(f), indices, count,
+                                        &vertices[f * count], dequantizeLevel);
+                    }
+                });
+                report(seconds, view.frameCount() * count * (sizeof(TriangleVertex) + sizeof(Vertex)));
+                if (memcmp(vertices.data(), reference.data(), view.frameCount() * count * sizeof(Vertex)) != 0)
+                    std::cout << "    differs from the scalar positions" << std::endl;
+            }
+        }
+    }
+
+    // size and error of the delta compressed frames against the float and the 8 bit frames, and
+    // the decode cost of playing every clip through a FrameRing and of jumping around in them
+    void benchCompression(const char *path, int iterations)
+    {
+        MD2Model model;
+        loadMD2(path, model);
+        FrameView<const Vertex> frames = model.baked.frames();
+        std::vector<AnimationClip> clips = buildClips(model.view, 10.0f);
+        size_t floatSize = frames.size() * sizeof(Vertex);
+        size_t compactSize = frames.size() * sizeof(TriangleVertex);
+        std::cout << "compressed animation, " << frames.frameCount() << " frames of " << frames.vertexCount()
+                  << " vertices, float " << floatSize / 1024 << " KB, compact " << compactSize / 1024 << " KB"
+                  << std::endl;
+
+        const float maxErrors[] = {0.01f, 0.05f, 0.1f, 0.25f};
+        for (float maxError : maxErrors) {
+            CompressedAnimation animation;
+            measure("build, max error " + std::to_string(maxError), iterations, [&]() {
+                animation.build(frames, clips, maxError);
+            });
+
+            float error = 0.0f;
+            double deltaBits = 0.0;
+            FrameRing ring(animation);
+            for (int f = 0; f < animation.frameCount(); f++) {
+                const Vertex *decoded = ring.frame(f);
+                for (size_t i = 0; i < frames.vertexCount(); i++) {
+                    for (size_t k = 0; k < 3; k++)
+                        error = std::max(error, std::fabs(decoded[i].coords[k] - frames[f][i].coords[k]));
+                }
+            }
+            for (const CompressedClip &clip : animation.clips())
+                deltaBits += clip.deltaBits * (clip.end - clip.start);
+            std::cout << "    " << animation.size() / 1024 << " KB, " << floatSize / (float) animation.size()
+                      << "x smaller than float, " << compactSize / (float) animation.size()
+                      << "x smaller than compact, " << deltaBits / (frames.frameCount() - animation.clips().size())
+                      << " bits per delta, max error " << error << std::endl;
+            if (error > maxError)
+                std::cerr << "error: max error " << error << " is above the bound " << maxError << std::endl;
+
+            int played = 0;
+            measure("  play every frame of every clip", iterations, [&]() {
+                FrameRing ring(animation, 2);
+                for (int f = 0; f < animation.frameCount(); f++)
+                    ring.frame(f);
+                played = ring.decodedFrames();
+            });
+            std::cout << "    " << played << " delta frames decoded" << std::endl;
+
+            measure("  " + std::to_string(animation.frameCount()) + " random frames", iterations, [&]() {
+                FrameRing ring(animation, 2);
+                unsigned int seed = 1;
+                for (int i = 0; i < animation.frameCount(); i++) {
+                    seed = seed * 1103515245 + 12345;
+                    ring.frame((seed >> 16) % animation.frameCount());
+                }
+                played = ring.decodedFrames();
+            });
+            std::cout << "    " << played << " delta frames decoded" << std::endl;
+        }
+        std::remove((std::string(path) + ".bake").c_str());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 5;
+    if (iterations < 1)
+        iterations = 1;
+
+    benchLoad("tris.md2", resource(tris.md2), iterations);
+    benchDequantize("tris.md2", resource(tris.md2), iterations);
+    benchAnimation(resource(tris.md2), iterations);
+    benchCompression(resource(tris.md2), iterations);
+    benchBatch(128, iterations);
+
+    const int sides[] = {16, 32, 45};
+    for (int side : sides) {
+        std::string path = "md2_bench_synthetic.md2";
+        std::vector<char> data = syntheticMD2(side, 200);
+        if (!writeFile(path.c_str(), data)) {
+            std::cerr << "can't write " << path << std::endl;
+            return 1;
+        }
+        benchLoad("synthetic " + std::to_string(side * side) + " vertices, " +
+                  std::to_string((side - 1) * (side - 1) * 2) + " triangles, 200 frames, " +
+                  std::to_string(data.size() / 1024) + " KB", path.c_str(), iterations);
+        benchDequantize("synthetic " + std::to_string(side * side) + " vertices", path.c_str(), iterations);
+        std::remove(path.c_str());
+    }
+    return 0;
+}
@@ -1,3 +1,6 @@
+#ifndef BIG_WALL_MD2_H
+#define BIG_WALL_MD2_H
+
 struct MD2 {
     int magic;
     int version;
@@ -35,6 +38,13 @@ struct Mesh {
     unsigned short stIndex[3];       // indices to texture coordinates
 };
 
+// one vertex of a glCommands strip or fan
+struct GlCommandVertex {
+    float s;
+    float t;
+    int vertexIndex;
+};
+
 struct pcxHeader
 {
     short id[2];
@@ -55,3 +65,5 @@ struct Vertex {
 struct VertexUV {
     GLfloat st[2];
 };
+
+#endif //BIG_WALL_MD2_H
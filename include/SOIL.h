@@ -390,6 +390,39 @@ unsigned char*
 		int force_channels
 	);
 
+/**
+	Loads an image from disk at 1/scale of its size, scale being 1, 2,
+	4 or 8, with each pixel the average of the scale x scale pixels it
+	covers; the size rounds up.  A JPEG is decoded straight at the
+	reduced size, which is much faster than decoding it whole.
+	*width and *height return the reduced size, *channels as in
+	SOIL_load_image.
+	\return 0 if failed, otherwise returns 1
+**/
+unsigned char*
+	SOIL_load_image_scaled
+	(
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels,
+		int scale
+	);
+
+/**
+	Loads an image from memory at 1/scale of its size, as
+	SOIL_load_image_scaled does.
+	\return 0 if failed, otherwise returns 1
+**/
+unsigned char*
+	SOIL_load_image_from_memory_scaled
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels,
+		int scale
+	);
+
 /**
 	Saves an image from an array of unsigned chars (RGBA) to disk
 	\return 0 if failed, otherwise returns 1
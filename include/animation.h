@@ -0,0 +1,61 @@
+#ifndef BIG_WALL_ANIMATION_H
+#define BIG_WALL_ANIMATION_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "md2_view.h"
+
+// A run of consecutive frames named after the same animation, "stand01" to "stand40" is the clip
+// stand with frames start to end
+struct AnimationClip {
+    std::string name;
+    int start;
+    int end;
+    float fps;
+
+    int length() const { return this->end - this->start + 1; }
+};
+
+// Groups the frames by their names with the frame number cut off, every clip plays at fps
+std::vector<AnimationClip> buildClips(const MD2View &view, float fps);
+
+// The clip called name, NULL when there is none
+const AnimationClip *findClip(const std::vector<AnimationClip> &clips, const std::string &name);
+
+// Plays one clip per instance. The state is kept as parallel arrays so update() is one branch free
+// pass over all instances, the frame, next and blend arrays can be uploaded as they are.
+class AnimationPlayer
+{
+public:
+    // Adds an instance time seconds into clip, returns its index
+    size_t add(const AnimationClip &clip, float time = 0.0f);
+    // Starts clip from its first frame on instance i
+    void play(size_t i, const AnimationClip &clip);
+    // Keeps the first count instances
+    void resize(size_t count);
+    size_t size() const { return this->time.size(); }
+
+    // Advances every instance by dt seconds, looping its clip. Without interpolate next is the
+    // current frame and blend is zero.
+    void update(float dt, bool interpolate);
+
+    // absolute frame indices as floats, ready for the instance attributes
+    const float *frames() const { return this->frame.data(); }
+    const float *nextFrames() const { return this->next.data(); }
+    const float *blends() const { return this->blend.data(); }
+
+private:
+    // seconds into the clip
+    std::vector<float> time;
+    std::vector<float> start;
+    std::vector<float> length;
+    std::vector<float> fps;
+
+    std::vector<float> frame;
+    std::vector<float> next;
+    std::vector<float> blend;
+};
+
+#endif //BIG_WALL_ANIMATION_H
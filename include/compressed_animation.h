@@ -0,0 +1,91 @@
+#ifndef BIG_WALL_COMPRESSED_ANIMATION_H
+#define BIG_WALL_COMPRESSED_ANIMATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glad/glad.h"
+#include "MD2.h"
+#include "animation.h"
+#include "frame_view.h"
+
+// One clip of a CompressedAnimation. The positions are snapped to a grid of step units starting at
+// origin, the first frame stores the grid coordinates with keyBits bits each and every following
+// frame the difference to the frame before it with deltaBits bits each.
+struct CompressedClip {
+    int start;
+    int end;
+    float origin[3];
+    int keyBits;
+    int deltaBits;
+    // first bit of the clip in the stream
+    size_t offset;
+};
+
+// Animation frames delta encoded clip by clip under an error bound, a fraction of the size of the
+// float frames. Frames are decoded in order through a FrameRing.
+class CompressedAnimation
+{
+public:
+    CompressedAnimation() : step(0.0f), frames(0), vertices(0) {}
+
+    // Encodes frames, every coordinate decodes to within maxError of the original. The bit widths
+    // are picked per clip, clips has to cover all frames in order.
+    void build(const FrameView<const Vertex> &frames, const std::vector<AnimationClip> &clips, float maxError);
+
+    int frameCount() const { return this->frames; }
+    int vertexCount() const { return this->vertices; }
+    const std::vector<CompressedClip> &clips() const { return this->clipTable; }
+    // bytes of the encoded frames and the clip table
+    size_t size() const;
+
+    // The clip frame belongs to
+    const CompressedClip &clip(int frame) const { return this->clipTable[this->frameClips[frame]]; }
+    // Grid coordinates of the first frame of clip
+    void decodeKey(const CompressedClip &clip, int32_t *grid) const;
+    // Adds the deltas of frame, which must not be the first of its clip, to the grid coordinates
+    // of the frame before it
+    void decodeDelta(int frame, int32_t *grid) const;
+    // Turns grid coordinates of a frame into positions
+    void toVertices(int frame, const int32_t *grid, Vertex *vertices) const;
+
+private:
+    float step;
+    int frames;
+    int vertices;
+    std::vector<CompressedClip> clipTable;
+    std::vector<int> frameClips;
+    // the bit stream, padded by one word so reads never need a bounds check
+    std::vector<uint32_t> bits;
+};
+
+// A few decoded frames of a CompressedAnimation. Asking for the frame after one in the ring costs a
+// single delta frame, anything else is decoded from the start of its clip. The least recently used
+// slot is reused.
+class FrameRing
+{
+public:
+    FrameRing(const CompressedAnimation &animation, size_t capacity = 8);
+
+    // the vertexCount() positions of frame, valid until capacity other frames were asked for
+    const Vertex *frame(int frame);
+
+    // delta frames decoded so far, for measuring
+    size_t decodedFrames() const { return this->decoded; }
+
+private:
+    struct Slot {
+        int frame;
+        unsigned int lastUse;
+        std::vector<int32_t> grid;
+        std::vector<Vertex> vertices;
+    };
+
+    const CompressedAnimation &animation;
+    std::vector<Slot> slots;
+    unsigned int clock;
+    size_t decoded;
+};
+
+#endif //BIG_WALL_COMPRESSED_ANIMATION_H
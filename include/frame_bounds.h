@@ -0,0 +1,27 @@
+#ifndef BIG_WALL_FRAME_BOUNDS_H
+#define BIG_WALL_FRAME_BOUNDS_H
+
+#include <vector>
+
+#include "glad/glad.h"
+#include "MD2.h"
+#include "animation.h"
+#include "frame_view.h"
+
+// Axis aligned box and bounding sphere of a character pose in model space, the sphere is centered
+// on the box
+struct Bounds {
+    float min[3];
+    float max[3];
+    float center[3];
+    float radius;
+};
+
+// The bounds of every frame
+std::vector<Bounds> buildFrameBounds(const FrameView<const Vertex> &frames);
+
+// One bounds per clip holding every frame of it, whatever frame an instance playing the clip is on
+// and however it blends towards the next one stays inside
+std::vector<Bounds> buildClipBounds(const std::vector<Bounds> &frameBounds, const std::vector<AnimationClip> &clips);
+
+#endif //BIG_WALL_FRAME_BOUNDS_H
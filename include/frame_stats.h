@@ -0,0 +1,55 @@
+#ifndef BIG_WALL_FRAME_STATS_H
+#define BIG_WALL_FRAME_STATS_H
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Collects frame times and prints average and percentiles every few seconds, used by the benchmark modes
+class FrameStats
+{
+public:
+    FrameStats(float interval = 2.0f) : interval(interval), elapsed(0.0f) {}
+
+    // Records one frame, returns true when the collected frames were reported
+    bool add(float frameTime, const std::string &label)
+    {
+        this->times.push_back(frameTime);
+        this->elapsed += frameTime;
+        if (this->elapsed < this->interval)
+            return false;
+
+        std::sort(this->times.begin(), this->times.end());
+        float total = 0.0f;
+        for (float t : this->times)
+            total += t;
+        std::cout << label << ": " << this->times.size() << " frames"
+                  << "  avg " << total / this->times.size() * 1000.0f << " ms"
+                  << "  p50 " << this->percentile(0.50f) * 1000.0f << " ms"
+                  << "  p95 " << this->percentile(0.95f) * 1000.0f << " ms"
+                  << "  p99 " << this->percentile(0.99f) * 1000.0f << " ms" << std::endl;
+        this->reset();
+        return true;
+    }
+
+    void reset()
+    {
+        this->times.clear();
+        this->elapsed = 0.0f;
+    }
+
+private:
+    std::vector<float> times;
+    float interval;
+    float elapsed;
+
+    // times must be sorted
+    float percentile(float p) const
+    {
+        size_t i = static_cast<size_t>(p * (this->times.size() - 1) + 0.5f);
+        return this->times[i];
+    }
+};
+
+#endif //BIG_WALL_FRAME_STATS_H
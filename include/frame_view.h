@@ -0,0 +1,30 @@
+#ifndef BIG_WALL_FRAME_VIEW_H
+#define BIG_WALL_FRAME_VIEW_H
+
+#include <cstddef>
+
+// Animation frames stored back to back in one array, frame i starts at vertex i * vertexCount(), so
+// a sweep over all frames is a single linear walk
+template <typename T>
+class FrameView
+{
+public:
+    FrameView() : base(NULL), frames(0), stride(0) {}
+    FrameView(T *data, size_t frameCount, size_t vertexCount) : base(data), frames(frameCount), stride(vertexCount) {}
+
+    size_t frameCount() const { return this->frames; }
+    size_t vertexCount() const { return this->stride; }
+    // all frameCount() * vertexCount() vertices
+    T *data() const { return this->base; }
+    size_t size() const { return this->frames * this->stride; }
+
+    T *frame(size_t i) const { return this->base + i * this->stride; }
+    T *operator[](size_t i) const { return this->frame(i); }
+
+private:
+    T *base;
+    size_t frames;
+    size_t stride;
+};
+
+#endif //BIG_WALL_FRAME_VIEW_H
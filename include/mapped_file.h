@@ -0,0 +1,33 @@
+#ifndef BIG_WALL_MAPPED_FILE_H
+#define BIG_WALL_MAPPED_FILE_H
+
+#include <cstddef>
+
+// A whole file mapped read-only into memory, pages are loaded by the os when first touched
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(MappedFile &&other);
+    MappedFile &operator=(MappedFile &&other);
+
+    bool open(const char *path);
+    void close();
+
+    const char *data() const { return this->mapping; }
+    size_t size() const { return this->length; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const char *mapping;
+    size_t length;
+#ifdef _WIN32
+    void *file;
+    void *fileMapping;
+#endif
+};
+
+#endif //BIG_WALL_MAPPED_FILE_H
@@ -0,0 +1,116 @@
+#ifndef BIG_WALL_MD2_BAKE_H
+#define BIG_WALL_MD2_BAKE_H
+
+#include <cstddef>
+
+#include "glad/glad.h"
+#include "MD2.h"
+#include "frame_view.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+
+// Bumped whenever the baked layout or the way the streams are built changes, older files are rebuilt
+const unsigned int BAKE_VERSION = 3;
+
+// Every stream starts on this boundary
+const size_t BAKE_ALIGNMENT = 64;
+
+// The mesh was built as a strip list from the gl commands
+const unsigned int BAKE_STRIPS = 1;
+
+// Start of a baked md2, the final gpu streams of the mesh follow at the given offsets so they can
+// go to glBufferData without being touched
+struct BakeHeader {
+    char magic[4];
+    unsigned int version;
+    unsigned int headerSize;
+    unsigned int flags;
+    // the md2 file the streams were built from
+    unsigned long long sourceSize;
+    unsigned long long sourceChecksum;
+
+    unsigned int frameCount;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    // triangle list indices of every simplified level of detail
+    unsigned int lodIndexCounts[LOD_LEVELS];
+    MeshStats stats;
+
+    // byte offsets from the start of the file
+    unsigned long long framesOffset;     // frameCount * vertexCount Vertex, frame after frame
+    unsigned long long quantizedOffset;  // frameCount * vertexCount TriangleVertex, frame after frame
+    unsigned long long normalsOffset;    // frameCount * vertexCount packed GLuint normals, frame after frame
+    unsigned long long stsOffset;        // vertexCount VertexUV
+    unsigned long long indicesOffset;    // indexCount GLushort
+    unsigned long long lodIndicesOffset; // the lodIndexCounts GLushort of every level, level after level
+    unsigned long long fileSize;
+};
+
+// 64 bit FNV-1a style hash of size bytes, taken a word at a time
+unsigned long long checksum(const char *data, size_t size);
+
+// Read-only view over a baked md2 in memory, like MD2View nothing is copied
+class BakedMD2
+{
+public:
+    BakedMD2() : base(NULL) {}
+
+    // Checks the header against the source file and the mesh options and that every stream lies
+    // inside size bytes, the data has to stay alive as long as the view is used
+    bool open(const char *data, size_t size, size_t sourceSize, unsigned long long sourceChecksum,
+              unsigned int flags);
+
+    bool valid() const { return this->base != NULL; }
+    const BakeHeader &header() const { return *reinterpret_cast<const BakeHeader *>(this->base); }
+
+    int frameCount() const { return this->valid() ? this->header().frameCount : 0; }
+    int vertexCount() const { return this->valid() ? this->header().vertexCount : 0; }
+    int indexCount() const { return this->valid() ? this->header().indexCount : 0; }
+
+    FrameView<const Vertex> frames() const
+    {
+        return FrameView<const Vertex>(this->stream<Vertex>(&BakeHeader::framesOffset), this->frameCount(),
+                                       this->vertexCount());
+    }
+    FrameView<const TriangleVertex> quantizedFrames() const
+    {
+        return FrameView<const TriangleVertex>(this->stream<TriangleVertex>(&BakeHeader::quantizedOffset),
+                                               this->frameCount(), this->vertexCount());
+    }
+    // GL_INT_2_10_10_10_REV normals lined up with the vertices of frames()
+    FrameView<const GLuint> normals() const
+    {
+        return FrameView<const GLuint>(this->stream<GLuint>(&BakeHeader::normalsOffset), this->frameCount(),
+                                       this->vertexCount());
+    }
+    const VertexUV *sts() const { return this->stream<VertexUV>(&BakeHeader::stsOffset); }
+    const GLushort *indices() const { return this->stream<GLushort>(&BakeHeader::indicesOffset); }
+
+    // level 0 is the full mesh, levels 1 to LOD_LEVELS the simplified triangle lists
+    int levelIndexCount(int level) const
+    {
+        if (!this->valid())
+            return 0;
+        return level == 0 ? this->header().indexCount : this->header().lodIndexCounts[level - 1];
+    }
+    const GLushort *levelIndices(int level) const
+    {
+        if (level == 0 || !this->valid())
+            return this->indices();
+        const GLushort *indices = this->stream<GLushort>(&BakeHeader::lodIndicesOffset);
+        for (int i = 1; i < level; i++)
+            indices += this->header().lodIndexCounts[i - 1];
+        return indices;
+    }
+
+private:
+    template <typename T>
+    const T *stream(unsigned long long BakeHeader::*offset) const
+    {
+        return this->valid() ? reinterpret_cast<const T *>(this->base + this->header().*offset) : NULL;
+    }
+
+    const char *base;
+};
+
+#endif //BIG_WALL_MD2_BAKE_H
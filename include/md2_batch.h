@@ -0,0 +1,23 @@
+#ifndef BIG_WALL_MD2_BATCH_H
+#define BIG_WALL_MD2_BATCH_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "md2_model.h"
+
+// The .md2 files in directory, sorted by name, empty when it can't be read
+std::vector<std::string> listMD2Files(const char *directory);
+
+// Loads every path with loadMD2 on threads worker threads, zero picks one per core. models[i] is
+// paths[i], a model that failed to load keeps an invalid baked view. Each loaded model is handed
+// to upload on the calling thread, which should own the GL context, while the workers carry on
+// with the others. Returns the number of models loaded. An exception from loadMD2 or upload stops
+// the workers once they finish the file they are on and is rethrown here.
+size_t loadMD2Batch(const std::vector<std::string> &paths, std::vector<MD2Model> &models,
+                    const std::function<void(size_t, MD2Model &)> &upload = nullptr, unsigned int threads = 0,
+                    bool glCommandStrips = false, bool useCache = true);
+
+#endif //BIG_WALL_MD2_BATCH_H
@@ -0,0 +1,28 @@
+#ifndef BIG_WALL_MD2_DEQUANTIZE_H
+#define BIG_WALL_MD2_DEQUANTIZE_H
+
+#include <cstddef>
+
+#include "glad/glad.h"
+#include "MD2.h"
+
+// Instruction sets dequantizeFrame can run on, every one gives bit identical positions
+enum DequantizeLevel {
+    DEQUANTIZE_SCALAR,
+    DEQUANTIZE_SSE2,
+    DEQUANTIZE_AVX2
+};
+
+// The widest level this build and cpu can run, checked once
+DequantizeLevel dequantizeSupport();
+
+// Name of a level for logs and benchmarks
+const char *dequantizeName(DequantizeLevel level);
+
+// Turns count md2 vertices of frame into positions, vertices[i] is source[indices[i]] times the
+// frame scale plus its translate with y and z swapped to y up. indices can be NULL to take the
+// source vertices in order. A level the cpu can't run falls back to the widest one it can.
+void dequantizeFrame(const Frame &frame, const TriangleVertex *source, const unsigned short *indices, size_t count,
+                     Vertex *vertices, DequantizeLevel level = dequantizeSupport());
+
+#endif //BIG_WALL_MD2_DEQUANTIZE_H
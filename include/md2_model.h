@@ -0,0 +1,71 @@
+#ifndef BIG_WALL_MD2_MODEL_H
+#define BIG_WALL_MD2_MODEL_H
+
+#include <vector>
+
+#include "glad/glad.h"
+#include "MD2.h"
+#include "md2_bake.h"
+#include "md2_view.h"
+#include "mapped_file.h"
+#include "mesh_simplifier.h"
+
+// An md2 file turned into an indexed mesh with one vertex array per animation frame, the file
+// itself stays mapped and is read through view
+struct MD2Model {
+    MappedFile file;
+    MD2View view;
+
+    // the final gpu streams, mapped from the bake cache next to the md2 file or kept in bakedData
+    // when the cache can't be written
+    MappedFile bakedFile;
+    std::vector<char> bakedData;
+    BakedMD2 baked;
+
+    // md2 vertex index of every mesh vertex, the uvs and indices are shared by all frames
+    std::vector<unsigned short> weldedVertices;
+    std::vector<VertexUV> sts;
+    std::vector<GLushort> indices;
+    // indices are a strip list with primitive restart instead of a triangle list
+    bool strips;
+    MeshStats stats;
+
+    // filled by buildMesh and decodeFrames, loadMD2 releases them once they are baked. The frames
+    // are stored back to back, frame i starts at vertex i * weldedVertices.size()
+    std::vector<Vertex> frameVertices;
+    std::vector<TriangleVertex> quantizedFrames;
+    // the md2 normal of every frame vertex packed as GL_INT_2_10_10_10_REV
+    std::vector<GLuint> frameNormals;
+    // triangle lists of the simplified levels of detail, over the same vertices as indices
+    std::vector<GLushort> lodIndices[LOD_LEVELS];
+};
+
+// Reads the whole file in one call
+bool readFile(const char *path, std::vector<char> &data);
+
+// Writes the file next to path first and renames it over, so a crash never leaves half a file
+bool writeFile(const char *path, const std::vector<char> &data);
+
+// Validates an md2 file in memory and points the model's view at it, data has to outlive the model
+bool parseMD2(const char *data, size_t size, MD2Model &model);
+
+// Welds and optimizes the triangle list, or builds the strip list from the gl commands
+void buildMesh(MD2Model &model, bool glCommandStrips);
+
+// Decodes every frame into the float and the quantized vertex arrays and the packed normals of the mesh
+void decodeFrames(MD2Model &model);
+
+// Builds the simplified levels of detail from the mesh and the decoded frames, each level with
+// about half the triangles of the one before
+void simplifyMesh(MD2Model &model);
+
+// Lays the built mesh and decoded frames out in the baked format, sourceChecksum is the checksum
+// of the md2 file they came from
+void bakeMD2(const MD2Model &model, unsigned long long sourceChecksum, std::vector<char> &baked);
+
+// Maps the file and points baked at the streams of path + ".bake" when it still matches the file,
+// otherwise does all of the above and writes the bake for the next run. With useCache false the
+// mesh is always rebuilt and only baked in memory. Errors are reported on std::cerr
+bool loadMD2(const char *path, MD2Model &model, bool glCommandStrips = false, bool useCache = true);
+
+#endif //BIG_WALL_MD2_MODEL_H
@@ -0,0 +1,20 @@
+#ifndef BIG_WALL_MD2_NORMALS_H
+#define BIG_WALL_MD2_NORMALS_H
+
+#include "glad/glad.h"
+
+// Size of the md2 normal table, TriangleVertex::lightNormalIndex is an index into it
+const int MD2_NORMAL_COUNT = 162;
+
+// The unit normals an md2 vertex picks from, z up like the md2 positions. They are the vertices of
+// an icosahedron with every face split into 16 triangles, pushed out onto the unit sphere.
+extern const float MD2_NORMALS[MD2_NORMAL_COUNT][3];
+
+// Packs a unit vector for GL_INT_2_10_10_10_REV with normalized on, x in the lowest bits and w zero
+GLuint packNormal(float x, float y, float z);
+
+// The packed normal of a lightNormalIndex with y and z swapped like the positions, indices past the
+// table pack to a zero vector
+GLuint md2Normal(unsigned char index);
+
+#endif //BIG_WALL_MD2_NORMALS_H
@@ -0,0 +1,73 @@
+#ifndef BIG_WALL_MD2_VIEW_H
+#define BIG_WALL_MD2_VIEW_H
+
+#include <cstddef>
+
+#include "glad/glad.h"
+#include "MD2.h"
+
+// Read-only views straight over an md2 file in memory, nothing is copied so only the parts that are
+// used get paged in. The accessors return NULL for indices out of range.
+class MD2View
+{
+public:
+    MD2View() : base(NULL), length(0) {}
+
+    // Checks the magic and that every table the header points at lies inside size bytes, the data
+    // has to stay alive as long as the view is used
+    bool open(const char *data, size_t size);
+
+    bool valid() const { return this->base != NULL; }
+    size_t size() const { return this->length; }
+    const MD2 &header() const { return *reinterpret_cast<const MD2 *>(this->base); }
+
+    int frameCount() const { return this->valid() ? this->header().numFrames : 0; }
+    int vertexCount() const { return this->valid() ? this->header().numVertices : 0; }
+    int uvCount() const { return this->valid() ? this->header().numTexCoords : 0; }
+    int triangleCount() const { return this->valid() ? this->header().numTriangles : 0; }
+    int glCommandCount() const { return this->valid() ? this->header().numGlCommands : 0; }
+
+    // frame header with scale, translate and name, its vertices come from frameVertices
+    const Frame *frame(int i) const
+    {
+        if (i < 0 || i >= this->frameCount())
+            return NULL;
+        return reinterpret_cast<const Frame *>(this->base + this->header().offsetFrames +
+                                               static_cast<size_t>(i) * this->header().frameSize);
+    }
+
+    // the vertexCount() packed vertices of frame i
+    const TriangleVertex *frameVertices(int i) const
+    {
+        const Frame *frame = this->frame(i);
+        return frame ? frame->vertices : NULL;
+    }
+
+    const MeshUV *uv(int i) const
+    {
+        if (i < 0 || i >= this->uvCount())
+            return NULL;
+        return reinterpret_cast<const MeshUV *>(this->base + this->header().offsetTexCoords) + i;
+    }
+
+    const Mesh *triangle(int i) const
+    {
+        if (i < 0 || i >= this->triangleCount())
+            return NULL;
+        return reinterpret_cast<const Mesh *>(this->base + this->header().offsetTriangles) + i;
+    }
+
+    // glCommandCount() ints
+    const int *glCommands() const
+    {
+        if (this->glCommandCount() == 0)
+            return NULL;
+        return reinterpret_cast<const int *>(this->base + this->header().offsetGlCommands);
+    }
+
+private:
+    const char *base;
+    size_t length;
+};
+
+#endif //BIG_WALL_MD2_VIEW_H
@@ -0,0 +1,52 @@
+#ifndef BIG_WALL_MESH_OPTIMIZER_H
+#define BIG_WALL_MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+
+// Post-transform cache size the optimizer and the statistics assume
+const size_t VERTEX_CACHE_SIZE = 16;
+
+// Reorders the triangles of an indexed triangle list so consecutive triangles reuse the vertices
+// still in the post-transform cache (Tom Forsyth, Linear-Speed Vertex Cache Optimisation)
+void optimizeVertexCache(std::vector<unsigned short> &indices, size_t vertexCount);
+
+// Renumbers the vertices in the order the triangles first use them so vertex fetch walks memory
+// forward, returns remap with remap[old] = new, vertex streams have to be permuted with it
+std::vector<unsigned short> optimizeVertexFetch(std::vector<unsigned short> &indices, size_t vertexCount);
+
+// Index that separates the strips of a strip list drawn with primitive restart
+const unsigned short PRIMITIVE_RESTART = 0xffff;
+
+// Appends a triangle fan, center vertex first, as strip indices with the same triangles and winding,
+// every second triangle after the third costs a degenerate pair
+void appendFanAsStrip(std::vector<unsigned short> &strip, const std::vector<unsigned short> &fan);
+
+// Expands a strip list with restarts into a triangle list, degenerate triangles are dropped
+std::vector<unsigned short> unpackStrips(const std::vector<unsigned short> &strips);
+
+// Average cache miss ratio, transformed vertices per triangle for a fifo cache of cacheSize
+float averageCacheMissRatio(const std::vector<unsigned short> &indices, size_t vertexCount,
+                            size_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Average transformed to vertex ratio, 1.0 means every vertex is shaded exactly once
+float averageTransformedVertexRatio(const std::vector<unsigned short> &indices, size_t vertexCount,
+                                    size_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Index buffer statistics gathered while building the mesh
+struct MeshStats {
+    // triangle list, before and after the vertex cache optimization
+    float acmrBefore;
+    float acmrAfter;
+    float atvrBefore;
+    float atvrAfter;
+    size_t listIndices;
+    size_t listVertices;
+    // strip list built from the gl commands
+    size_t stripIndices;
+    size_t stripVertices;
+    size_t strips;
+    float stripAcmr;
+};
+
+#endif //BIG_WALL_MESH_OPTIMIZER_H
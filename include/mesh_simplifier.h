@@ -0,0 +1,31 @@
+#ifndef BIG_WALL_MESH_SIMPLIFIER_H
+#define BIG_WALL_MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "glad/glad.h"
+#include "MD2.h"
+#include "frame_view.h"
+
+// Simplified levels of detail built for every model on top of the full mesh, each one has about
+// half the triangles of the level before it
+const int LOD_LEVELS = 3;
+
+// Frames the collapse errors are measured on, spread evenly over the animation
+const int SIMPLIFY_SAMPLE_FRAMES = 32;
+
+// Simplifies an animated triangle list down to about targets[i] triangles for every i by
+// collapsing vertices onto one of their neighbours, cheapest quadric error first (Garland and
+// Heckbert, Surface Simplification Using Quadric Error Metrics). One collapse sequence serves all
+// frames, the error of a collapse is summed over a sample of frames and a vertex only ever moves
+// onto another vertex, so every level indexes the same frame streams. positions gives every vertex
+// the position it was welded from, the copies a uv seam splits a position into collapse together
+// along the seam. targets go from large to small, returns one cache optimized triangle list per
+// target, a target the mesh can't get down to gets the smallest mesh reached.
+std::vector<std::vector<unsigned short>> simplifyAnimatedMesh(const std::vector<unsigned short> &indices,
+                                                              const std::vector<unsigned short> &positions,
+                                                              const FrameView<const Vertex> &frames,
+                                                              const std::vector<size_t> &targets);
+
+#endif //BIG_WALL_MESH_SIMPLIFIER_H
@@ -25,6 +25,206 @@ namespace glsl {
     );
 
 
+    // blends two animation frames, position is the current frame and nextPosition the one after it,
+    // the packed md2 normals of both frames come in as normal and nextNormal
+    const char *animVShader = GLSL
+    (
+            layout(location = 0) in vec3 position;
+            layout(location = 1) in vec2 texCoord;
+            layout(location = 2) in vec3 nextPosition;
+            layout(location = 10) in vec3 normal;
+            layout(location = 11) in vec3 nextNormal;
+            uniform mat4 model;
+            uniform mat4 view;
+            uniform mat4 projection;
+            uniform float blend;
+            out vec2 TexCoord;
+            out vec3 Normal;
+            void main() {
+                gl_Position = projection * view * model * vec4(mix(position, nextPosition, blend), 1.0);
+                TexCoord = texCoord;
+                Normal = mat3(model) * mix(normal, nextNormal, blend);
+            }
+    );
+
+    // same as animVShader but the frames are the raw 8 bit md2 vertices, each frame brings its own
+    // scale and translate, y and z are swapped after dequantization
+    const char *quantVShader = GLSL
+    (
+            layout(location = 0) in vec3 position;
+            layout(location = 1) in vec2 texCoord;
+            layout(location = 2) in vec3 nextPosition;
+            layout(location = 10) in vec3 normal;
+            layout(location = 11) in vec3 nextNormal;
+            uniform mat4 model;
+            uniform mat4 view;
+            uniform mat4 projection;
+            uniform vec3 scale;
+            uniform vec3 translate;
+            uniform vec3 nextScale;
+            uniform vec3 nextTranslate;
+            uniform float blend;
+            out vec2 TexCoord;
+            out vec3 Normal;
+            void main() {
+                vec3 current = position * scale + translate;
+                vec3 next = nextPosition * nextScale + nextTranslate;
+                gl_Position = projection * view * model * vec4(mix(current, next, blend).xzy, 1.0);
+                TexCoord = texCoord;
+                Normal = mat3(model) * mix(normal, nextNormal, blend);
+            }
+    );
+
+    // crowd drawn with one instanced draw, every instance brings its model matrix and its current
+    // frame, next frame and blend, the frames are read from a buffer texture of frame after frame
+    // of float vertices, gl_VertexID is the mesh vertex. The normals are a second buffer texture of
+    // the packed 10:10:10:2 normals laid out the same way
+    const char *crowdVShader = GLSL
+    (
+            layout(location = 1) in vec2 texCoord;
+            layout(location = 3) in mat4 instanceModel;
+            layout(location = 7) in float instanceFrame;
+            layout(location = 8) in float instanceNext;
+            layout(location = 9) in float instanceBlend;
+            uniform mat4 view;
+            uniform mat4 projection;
+            uniform samplerBuffer frames;
+            uniform usamplerBuffer normals;
+            uniform int vertexCount;
+            out vec2 TexCoord;
+            out vec3 Normal;
+            vec3 frameNormal(int frame) {
+                int bits = int(texelFetch(normals, frame * vertexCount + gl_VertexID).r);
+                ivec3 normal = ivec3(bits << 22, bits << 12, bits << 2) >> 22;
+                return max(vec3(normal) / 511.0, -1.0);
+            }
+            void main() {
+                vec3 current = texelFetch(frames, int(instanceFrame) * vertexCount + gl_VertexID).xyz;
+                vec3 next = texelFetch(frames, int(instanceNext) * vertexCount + gl_VertexID).xyz;
+                gl_Position = projection * view * instanceModel * vec4(mix(current, next, instanceBlend), 1.0);
+                TexCoord = texCoord;
+                Normal = mat3(instanceModel) * mix(frameNormal(int(instanceFrame)), frameNormal(int(instanceNext)),
+                                                   instanceBlend);
+            }
+    );
+
+    // crowdVShader over the raw 8 bit md2 vertices, frameTable holds the scale and the translate of
+    // every frame as two texels
+    const char *crowdQuantVShader = GLSL
+    (
+            layout(location = 1) in vec2 texCoord;
+            layout(location = 3) in mat4 instanceModel;
+            layout(location = 7) in float instanceFrame;
+            layout(location = 8) in float instanceNext;
+            layout(location = 9) in float instanceBlend;
+            uniform mat4 view;
+            uniform mat4 projection;
+            uniform usamplerBuffer frames;
+            uniform samplerBuffer frameTable;
+            uniform usamplerBuffer normals;
+            uniform int vertexCount;
+            out vec2 TexCoord;
+            out vec3 Normal;
+            vec3 frameVertex(int frame) {
+                vec3 position = vec3(texelFetch(frames, frame * vertexCount + gl_VertexID).xyz);
+                return position * texelFetch(frameTable, frame * 2).xyz + texelFetch(frameTable, frame * 2 + 1).xyz;
+            }
+            vec3 frameNormal(int frame) {
+                int bits = int(texelFetch(normals, frame * vertexCount + gl_VertexID).r);
+                ivec3 normal = ivec3(bits << 22, bits << 12, bits << 2) >> 22;
+                return max(vec3(normal) / 511.0, -1.0);
+            }
+            void main() {
+                vec3 position = mix(frameVertex(int(instanceFrame)), frameVertex(int(instanceNext)), instanceBlend);
+                gl_Position = projection * view * instanceModel * vec4(position.xzy, 1.0);
+                TexCoord = texCoord;
+                Normal = mat3(instanceModel) * mix(frameNormal(int(instanceFrame)), frameNormal(int(instanceNext)),
+                                                   instanceBlend);
+            }
+    );
+
+    // crowdVShader over the vertex animation texture, one row of half float positions per frame
+    // with a column per mesh vertex, and a texture of the packed normals laid out the same way
+    const char *crowdTextureVShader = GLSL
+    (
+            layout(location = 1) in vec2 texCoord;
+            layout(location = 3) in mat4 instanceModel;
+            layout(location = 7) in float instanceFrame;
+            layout(location = 8) in float instanceNext;
+            layout(location = 9) in float instanceBlend;
+            uniform mat4 view;
+            uniform mat4 projection;
+            uniform sampler2D frames;
+            uniform usampler2D normals;
+            out vec2 TexCoord;
+            out vec3 Normal;
+            vec3 frameNormal(int frame) {
+                int bits = int(texelFetch(normals, ivec2(gl_VertexID, frame), 0).r);
+                ivec3 normal = ivec3(bits << 22, bits << 12, bits << 2) >> 22;
+                return max(vec3(normal) / 511.0, -1.0);
+            }
+            void main() {
+                vec3 current = texelFetch(frames, ivec2(gl_VertexID, int(instanceFrame)), 0).xyz;
+                vec3 next = texelFetch(frames, ivec2(gl_VertexID, int(instanceNext)), 0).xyz;
+                gl_Position = projection * view * instanceModel * vec4(mix(current, next, instanceBlend), 1.0);
+                TexCoord = texCoord;
+                Normal = mat3(instanceModel) * mix(frameNormal(int(instanceFrame)), frameNormal(int(instanceNext)),
+                                                   instanceBlend);
+            }
+    );
+
+    // distant crowd members as quads facing the nearest baked view. The atlas has a layer per frame
+    // split into grid x grid views over the upper hemisphere, laid out octahedrally, each one an
+    // orthographic picture of the sphere bounds in model space from its direction
+    const char *impostorVShader = GLSL
+    (
+            layout(location = 3) in mat4 instanceModel;
+            layout(location = 7) in float instanceFrame;
+            uniform mat4 view;
+            uniform mat4 projection;
+            uniform vec3 eye;
+            uniform vec4 bounds;
+            uniform int grid;
+            out vec3 TexCoord;
+            vec3 cellDirection(vec2 cell) {
+                vec2 hemi = (cell + 0.5) / float(grid) * 2.0 - 1.0;
+                vec2 oct = vec2(hemi.x + hemi.y, hemi.x - hemi.y) * 0.5;
+                return normalize(vec3(oct.x, 1.0 - abs(oct.x) - abs(oct.y), oct.y));
+            }
+            void main() {
+                vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+                vec3 center = (instanceModel * vec4(bounds.xyz, 1.0)).xyz;
+                vec3 toEye = transpose(mat3(instanceModel)) * (eye - center);
+                toEye.y = max(toEye.y, 0.0);
+                vec3 direction = toEye / (abs(toEye.x) + toEye.y + abs(toEye.z) + 1e-6);
+                vec2 hemi = vec2(direction.x + direction.z, direction.x - direction.z);
+                vec2 cell = clamp(floor((hemi * 0.5 + 0.5) * float(grid)), 0.0, float(grid - 1));
+
+                vec3 look = cellDirection(cell);
+                vec3 up = abs(look.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+                vec3 right = normalize(cross(up, look));
+                up = cross(look, right);
+                vec3 offset = (right * corner.x + up * corner.y) * bounds.w;
+                gl_Position = projection * view * instanceModel * vec4(bounds.xyz + offset, 1.0);
+                TexCoord = vec3((cell + corner * 0.5 + 0.5) / float(grid), instanceFrame);
+            }
+    );
+
+    // the baked lighting as it is, the empty parts of a view are cut out
+    const char *impostorFShader = GLSL
+    (
+            in vec3 TexCoord;
+            out vec4 color;
+
+            uniform sampler2DArray impostors;
+            void main() {
+                vec4 texel = texture(impostors, TexCoord);
+                if (texel.a < 0.5)
+                    discard;
+                color = vec4(texel.rgb / texel.a, 1.0);
+            }
+    );
+
     const char *fShader = GLSL
     (
             in vec2 TexCoord;
@@ -36,6 +236,22 @@ namespace glsl {
             }
     );
 
+    // fShader with one directional light from above for the animated characters
+    const char *litFShader = GLSL
+    (
+            in vec2 TexCoord;
+            in vec3 Normal;
+            out vec4 color;
+
+            uniform sampler2D texture1;
+            void main() {
+                vec3 light = normalize(vec3(0.3, 1.0, 0.5));
+                float diffuse = max(dot(normalize(Normal), light), 0.0);
+                vec4 texel = texture(texture1, TexCoord);
+                color = vec4(texel.rgb * (0.4 + 0.6 * diffuse), texel.a);
+            }
+    );
+
     const char *skyVShader = GLSL
     (
             layout(location = 0) in vec3 position;
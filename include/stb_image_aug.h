@@ -14,6 +14,7 @@
       writes BMP,TGA (define STBI_NO_WRITE to remove code)
       decoded from memory or through stdio FILE (define STBI_NO_STDIO to remove code)
       supports installable dequantizing-IDCT, YCbCr-to-RGB conversion (define STBI_SIMD)
+      decodes jpegs on several threads (define STBI_NO_THREADS to remove code)
         
    TODO:
       stbi_info_*
@@ -160,6 +161,12 @@
 
 #define STBI_VERSION 1
 
+// the installable IDCT and color conversion are always compiled in, by default the decoder
+// installs the widest built-in kernels the cpu can run (define STBI_SIMD 0 to take them out)
+#ifndef STBI_SIMD
+#define STBI_SIMD 1
+#endif
+
 enum
 {
    STBI_default = 0, // only used for req_comp
@@ -188,7 +195,9 @@ extern int      stbi_write_tga       (char const *filename,     int x, int y, in
 
 // PRIMARY API - works on images of any type
 
-// load image by filename, open file, or memory buffer
+// load image by filename, open file, or memory buffer. A file loaded by name is mapped into
+// memory (or read whole where it can't be) and decoded like a buffer, an open file is read
+// through stdio.
 #ifndef STBI_NO_STDIO
 extern stbi_uc *stbi_load            (char const *filename,     int *x, int *y, int *comp, int req_comp);
 extern stbi_uc *stbi_load_from_file  (FILE *f,                  int *x, int *y, int *comp, int req_comp);
@@ -197,6 +206,14 @@ extern int      stbi_info_from_file  (FILE *f,                  int *x, int *y,
 extern stbi_uc *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 
+// load an image at 1/scale of its size, scale is 1, 2, 4 or 8 and *x, *y round up. Every pixel
+// is the average of the ones it covers: a jpeg computes it from the DCT coefficients with a
+// reduced IDCT and never builds the full image, other formats are decoded whole and box filtered.
+#ifndef STBI_NO_STDIO
+extern stbi_uc *stbi_load_scaled            (char const *filename,     int *x, int *y, int *comp, int req_comp, int scale);
+#endif
+extern stbi_uc *stbi_load_from_memory_scaled(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, int scale);
+
 #ifndef STBI_NO_HDR
 #ifndef STBI_NO_STDIO
 extern float *stbi_loadf            (char const *filename,     int *x, int *y, int *comp, int req_comp);
@@ -242,10 +259,12 @@ extern int   stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const cha
 // is it a jpeg?
 extern int      stbi_jpeg_test_memory     (stbi_uc const *buffer, int len);
 extern stbi_uc *stbi_jpeg_load_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
+extern stbi_uc *stbi_jpeg_load_from_memory_scaled(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, int scale);
 extern int      stbi_jpeg_info_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp);
 
 #ifndef STBI_NO_STDIO
 extern stbi_uc *stbi_jpeg_load            (char const *filename,     int *x, int *y, int *comp, int req_comp);
+extern stbi_uc *stbi_jpeg_load_scaled     (char const *filename,     int *x, int *y, int *comp, int req_comp, int scale);
 extern int      stbi_jpeg_test_file       (FILE *f);
 extern stbi_uc *stbi_jpeg_load_from_file  (FILE *f,                  int *x, int *y, int *comp, int req_comp);
 
@@ -302,7 +321,7 @@ extern int      stbi_hdr_test_memory      (stbi_uc const *buffer, int len);
 extern float *  stbi_hdr_load             (char const *filename,     int *x, int *y, int *comp, int req_comp);
 extern float *  stbi_hdr_load_from_memory (stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
 extern stbi_uc *stbi_hdr_load_rgbe        (char const *filename,           int *x, int *y, int *comp, int req_comp);
-extern float *  stbi_hdr_load_from_memory (stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp);
+extern stbi_uc *stbi_hdr_load_rgbe_memory(stbi_uc *buffer, int len, int *x, int *y, int *comp, int req_comp);
 #ifndef STBI_NO_STDIO
 extern int      stbi_hdr_test_file        (FILE *f);
 extern float *  stbi_hdr_load_from_file   (FILE *f,                  int *x, int *y, int *comp, int req_comp);
@@ -327,23 +346,45 @@ extern int stbi_register_loader(stbi_loader *loader);
 
 // define faster low-level operations (typically SIMD support)
 #if STBI_SIMD
-typedef void (*stbi_idct_8x8)(uint8 *out, int out_stride, short data[64], unsigned short *dequantize);
+typedef void (*stbi_idct_8x8)(stbi_uc *out, int out_stride, short data[64], unsigned short *dequantize);
 // compute an integer IDCT on "input"
 //     input[x] = data[x] * dequantize[x]
 //     write results to 'out': 64 samples, each run of 8 spaced by 'out_stride'
 //                             CLAMP results to 0..255
-typedef void (*stbi_YCbCr_to_RGB_run)(uint8 *output, uint8 const *y, uint8 const *cb, uint8 const *cr, int count, int step);
+typedef void (*stbi_YCbCr_to_RGB_run)(stbi_uc *output, stbi_uc const *y, stbi_uc const *cb, stbi_uc const *cr, int count, int step);
 // compute a conversion from YCbCr to RGB
 //     'count' pixels
 //     write pixels to 'output'; each pixel is 'step' bytes (either 3 or 4; if 4, write '255' as 4th), order R,G,B
+//     nothing past the 'count' pixels may be written, rows can be converted on several threads at once
 //     y: Y input channel
 //     cb: Cb input channel; scale/biased to be 0..255
 //     cr: Cr input channel; scale/biased to be 0..255
 
 extern void stbi_install_idct(stbi_idct_8x8 func);
 extern void stbi_install_YCbCr_to_RGB(stbi_YCbCr_to_RGB_run func);
+
+// instruction sets of the built-in kernels, every one decodes bit identical images
+enum
+{
+   STBI_simd_scalar = 0,
+   STBI_simd_sse2,
+   STBI_simd_avx2,
+};
+
+// the widest level this build and cpu can run, what the decoder installs unless told otherwise
+extern int  stbi_simd_support(void);
+// install the built-in kernels of a level, one the cpu can't run falls back to the widest it can
+extern void stbi_simd_install(int level);
 #endif // STBI_SIMD
 
+#ifndef STBI_NO_THREADS
+// threads a jpeg decode runs on: the restart intervals of a jpeg in memory are entropy decoded
+// in parallel and every jpeg is upsampled and color converted in row bands. 0 (the default) is
+// one thread per cpu, 1 decodes on the calling thread only. Every count decodes the same image.
+extern void stbi_set_thread_count(int count);
+extern int  stbi_thread_count(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
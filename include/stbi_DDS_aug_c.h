@@ -495,10 +495,10 @@ stbi_uc *stbi_dds_load_from_file   (FILE *f,                  int *x, int *y, in
 stbi_uc *stbi_dds_load             (char *filename,           int *x, int *y, int *comp, int req_comp)
 {
    stbi_uc *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_dds_load_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_bytes b;
+   if (!open_file_bytes(&b, filename)) return NULL;
+   data = stbi_dds_load_from_memory(b.data, b.len, x,y,comp,req_comp);
+   close_file_bytes(&b);
    return data;
 }
 #endif
@@ -1464,6 +1464,51 @@ unsigned char*
 	return result;
 }
 
+unsigned char*
+	SOIL_load_image_scaled
+	(
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels,
+		int scale
+	)
+{
+	unsigned char *result = stbi_load_scaled( filename,
+			width, height, channels, force_channels, scale );
+	if( result == NULL )
+	{
+		result_string_pointer = stbi_failure_reason();
+	} else
+	{
+		result_string_pointer = "Image loaded";
+	}
+	return result;
+}
+
+unsigned char*
+	SOIL_load_image_from_memory_scaled
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels,
+		int scale
+	)
+{
+	unsigned char *result = stbi_load_from_memory_scaled(
+				buffer, buffer_length,
+				width, height, channels,
+				force_channels, scale );
+	if( result == NULL )
+	{
+		result_string_pointer = stbi_failure_reason();
+	} else
+	{
+		result_string_pointer = "Image loaded from memory";
+	}
+	return result;
+}
+
 int
 	SOIL_save_image
 	(
@@ -0,0 +1,113 @@
+#include "animation.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+    // "stand01" is the frame 01 of stand, three or more digits like "pain101" are the variant 1 of
+    // pain followed by a two digit frame number
+    std::string clipName(const char *frameName)
+    {
+        size_t length = strnlen(frameName, sizeof(Frame::name));
+        size_t digits = 0;
+        while (digits < length && std::isdigit(static_cast<unsigned char>(frameName[length - digits - 1])))
+            digits++;
+        if (digits >= 3)
+            digits = 2;
+        return std::string(frameName, length - digits);
+    }
+
+    // One tick of every instance. The arrays never overlap, without restrict the compiler would have
+    // to check seven pointers against each other at run time and gives up on vectorizing. Positions
+    // are never negative so truncating is flooring, unlike std::floor that vectorizes without
+    // sse4.1, and the wrap arounds are integer arithmetic instead of branches.
+    void advance(size_t count, float dt, float interpolation, float *__restrict time,
+                 const float *__restrict start, const float *__restrict length, const float *__restrict fps,
+                 float *__restrict frame, float *__restrict next, float *__restrict blend)
+    {
+        for (size_t i = 0; i < count; i++) {
+            float position = (time[i] + dt) * fps[i];
+            position -= static_cast<float>(static_cast<int>(position / length[i])) * length[i];
+            time[i] = position / fps[i];
+
+            int frames = static_cast<int>(length[i]);
+            int current = static_cast<int>(position);
+            current -= current >= frames;
+            int following = current + 1;
+            following -= (following >= frames) * frames;
+
+            frame[i] = start[i] + current;
+            next[i] = start[i] + current + (following - current) * interpolation;
+            blend[i] = (position - current) * interpolation;
+        }
+    }
+}
+
+std::vector<AnimationClip> buildClips(const MD2View &view, float fps)
+{
+    std::vector<AnimationClip> clips;
+    for (int i = 0; i < view.frameCount(); i++) {
+        std::string name = clipName(view.frame(i)->name);
+        if (!clips.empty() && clips.back().name == name) {
+            clips.back().end = i;
+            continue;
+        }
+
+        AnimationClip clip;
+        clip.name = name;
+        clip.start = i;
+        clip.end = i;
+        clip.fps = fps;
+        clips.push_back(clip);
+    }
+    return clips;
+}
+
+const AnimationClip *findClip(const std::vector<AnimationClip> &clips, const std::string &name)
+{
+    for (const AnimationClip &clip : clips) {
+        if (clip.name == name)
+            return &clip;
+    }
+    return NULL;
+}
+
+size_t AnimationPlayer::add(const AnimationClip &clip, float time)
+{
+    this->time.push_back(time);
+    this->start.push_back(clip.start);
+    this->length.push_back(clip.length());
+    this->fps.push_back(clip.fps);
+    this->frame.push_back(clip.start);
+    this->next.push_back(clip.start);
+    this->blend.push_back(0.0f);
+    return this->time.size() - 1;
+}
+
+void AnimationPlayer::play(size_t i, const AnimationClip &clip)
+{
+    this->time[i] = 0.0f;
+    this->start[i] = clip.start;
+    this->length[i] = clip.length();
+    this->fps[i] = clip.fps;
+}
+
+void AnimationPlayer::resize(size_t count)
+{
+    if (count >= this->size())
+        return;
+    this->time.resize(count);
+    this->start.resize(count);
+    this->length.resize(count);
+    this->fps.resize(count);
+    this->frame.resize(count);
+    this->next.resize(count);
+    this->blend.resize(count);
+}
+
+void AnimationPlayer::update(float dt, bool interpolate)
+{
+    advance(this->time.size(), dt, interpolate ? 1.0f : 0.0f, this->time.data(), this->start.data(),
+            this->length.data(), this->fps.data(), this->frame.data(), this->next.data(), this->blend.data());
+}
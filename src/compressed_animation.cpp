@@ -0,0 +1,219 @@
+#include "compressed_animation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+    // Appends values of up to 32 bits to a stream of words, lowest bits first
+    class BitWriter
+    {
+    public:
+        BitWriter(std::vector<uint32_t> &words) : words(words), pending(0), pendingBits(0), written(0) {}
+
+        size_t position() const { return this->written; }
+
+        void write(uint32_t value, int bits)
+        {
+            if (bits == 0)
+                return;
+            this->pending |= static_cast<uint64_t>(value) << this->pendingBits;
+            this->pendingBits += bits;
+            this->written += bits;
+            while (this->pendingBits >= 32) {
+                this->words.push_back(static_cast<uint32_t>(this->pending));
+                this->pending >>= 32;
+                this->pendingBits -= 32;
+            }
+        }
+
+        // flushes the last word and adds the padding word the reader relies on
+        void finish()
+        {
+            if (this->pendingBits > 0)
+                this->words.push_back(static_cast<uint32_t>(this->pending));
+            this->words.push_back(0);
+            this->pending = 0;
+            this->pendingBits = 0;
+        }
+
+    private:
+        std::vector<uint32_t> &words;
+        uint64_t pending;
+        int pendingBits;
+        size_t written;
+    };
+
+    // bits at position, the word after the one it starts in always exists
+    inline uint32_t readBits(const uint32_t *words, size_t position, int bits)
+    {
+        const uint32_t *word = words + (position >> 5);
+        uint64_t window = word[0] | static_cast<uint64_t>(word[1]) << 32;
+        return static_cast<uint32_t>((window >> (position & 31)) & ((static_cast<uint64_t>(1) << bits) - 1));
+    }
+
+    // small deltas of either sign become small unsigned values
+    inline uint32_t zigzag(int32_t value)
+    {
+        return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    }
+
+    inline int32_t unzigzag(uint32_t value)
+    {
+        return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+
+    int bitsFor(uint32_t value)
+    {
+        int bits = 0;
+        while (value >> bits)
+            bits++;
+        return bits;
+    }
+}
+
+void CompressedAnimation::build(const FrameView<const Vertex> &frames, const std::vector<AnimationClip> &clips,
+                                float maxError)
+{
+    this->frames = frames.frameCount();
+    this->vertices = frames.vertexCount();
+    // rounding to the nearest grid point is off by at most half a step, and the float math of the
+    // encode and of origin + grid * step adds a few ulps of the largest coordinate on top of that
+    float magnitude = 0.0f;
+    for (int f = 0; f < this->frames; f++) {
+        for (int i = 0; i < this->vertices; i++) {
+            for (size_t k = 0; k < 3; k++)
+                magnitude = std::max(magnitude, std::fabs(frames[f][i].coords[k]));
+        }
+    }
+    float rounding = 8.0f * std::numeric_limits<float>::epsilon() * magnitude;
+    this->step = 2.0f * std::max(maxError - rounding, 0.5f * maxError);
+    this->clipTable.clear();
+    this->frameClips.assign(this->frames, 0);
+    this->bits.clear();
+
+    BitWriter writer(this->bits);
+    size_t coords = this->vertices * 3;
+    for (const AnimationClip &clip : clips) {
+        CompressedClip compressed;
+        compressed.start = clip.start;
+        compressed.end = clip.end;
+        for (size_t k = 0; k < 3; k++)
+            compressed.origin[k] = std::numeric_limits<float>::max();
+        for (int f = clip.start; f <= clip.end; f++) {
+            for (int i = 0; i < this->vertices; i++) {
+                for (size_t k = 0; k < 3; k++)
+                    compressed.origin[k] = std::min(compressed.origin[k], frames[f][i].coords[k]);
+            }
+        }
+
+        // the grid coordinates are needed twice, for the bit widths and for writing them
+        std::vector<int32_t> grid(clip.length() * coords);
+        for (int f = clip.start; f <= clip.end; f++) {
+            int32_t *frameGrid = &grid[(f - clip.start) * coords];
+            for (int i = 0; i < this->vertices; i++) {
+                for (size_t k = 0; k < 3; k++) {
+                    float position = (frames[f][i].coords[k] - compressed.origin[k]) / this->step;
+                    frameGrid[i * 3 + k] = static_cast<int32_t>(std::lround(position));
+                }
+            }
+        }
+
+        uint32_t keyMax = 0, deltaMax = 0;
+        for (size_t i = 0; i < coords; i++)
+            keyMax = std::max(keyMax, static_cast<uint32_t>(grid[i]));
+        for (size_t i = coords; i < grid.size(); i++)
+            deltaMax = std::max(deltaMax, zigzag(grid[i] - grid[i - coords]));
+        compressed.keyBits = bitsFor(keyMax);
+        compressed.deltaBits = bitsFor(deltaMax);
+        compressed.offset = writer.position();
+
+        for (size_t i = 0; i < coords; i++)
+            writer.write(grid[i], compressed.keyBits);
+        for (size_t i = coords; i < grid.size(); i++)
+            writer.write(zigzag(grid[i] - grid[i - coords]), compressed.deltaBits);
+
+        for (int f = clip.start; f <= clip.end; f++)
+            this->frameClips[f] = this->clipTable.size();
+        this->clipTable.push_back(compressed);
+    }
+    writer.finish();
+}
+
+size_t CompressedAnimation::size() const
+{
+    return this->bits.size() * sizeof(uint32_t) + this->clipTable.size() * sizeof(CompressedClip) +
+           this->frameClips.size() * sizeof(int);
+}
+
+void CompressedAnimation::decodeKey(const CompressedClip &clip, int32_t *grid) const
+{
+    size_t coords = this->vertices * 3;
+    size_t position = clip.offset;
+    for (size_t i = 0; i < coords; i++, position += clip.keyBits)
+        grid[i] = readBits(this->bits.data(), position, clip.keyBits);
+}
+
+void CompressedAnimation::decodeDelta(int frame, int32_t *grid) const
+{
+    const CompressedClip &clip = this->clip(frame);
+    size_t coords = this->vertices * 3;
+    size_t position = clip.offset + coords * clip.keyBits + (frame - clip.start - 1) * coords * clip.deltaBits;
+    for (size_t i = 0; i < coords; i++, position += clip.deltaBits)
+        grid[i] += unzigzag(readBits(this->bits.data(), position, clip.deltaBits));
+}
+
+void CompressedAnimation::toVertices(int frame, const int32_t *grid, Vertex *vertices) const
+{
+    const CompressedClip &clip = this->clip(frame);
+    for (int i = 0; i < this->vertices; i++) {
+        for (size_t k = 0; k < 3; k++)
+            vertices[i].coords[k] = clip.origin[k] + grid[i * 3 + k] * this->step;
+    }
+}
+
+FrameRing::FrameRing(const CompressedAnimation &animation, size_t capacity)
+    : animation(animation), slots(capacity), clock(0), decoded(0)
+{
+    for (Slot &slot : this->slots) {
+        slot.frame = -1;
+        slot.lastUse = 0;
+        slot.grid.resize(animation.vertexCount() * 3);
+        slot.vertices.resize(animation.vertexCount());
+    }
+}
+
+const Vertex *FrameRing::frame(int frame)
+{
+    this->clock++;
+    Slot *target = &this->slots[0];
+    Slot *previous = NULL;
+    const CompressedClip &clip = this->animation.clip(frame);
+    for (Slot &slot : this->slots) {
+        if (slot.frame == frame) {
+            slot.lastUse = this->clock;
+            return slot.vertices.data();
+        }
+        if (slot.lastUse < target->lastUse)
+            target = &slot;
+        if (frame > clip.start && slot.frame == frame - 1)
+            previous = &slot;
+    }
+
+    if (previous) {
+        if (previous != target)
+            target->grid = previous->grid;
+        this->animation.decodeDelta(frame, target->grid.data());
+        this->decoded++;
+    } else {
+        this->animation.decodeKey(clip, target->grid.data());
+        for (int f = clip.start + 1; f <= frame; f++)
+            this->animation.decodeDelta(f, target->grid.data());
+        this->decoded += frame - clip.start;
+    }
+    this->animation.toVertices(frame, target->grid.data(), target->vertices.data());
+    target->frame = frame;
+    target->lastUse = this->clock;
+    return target->vertices.data();
+}
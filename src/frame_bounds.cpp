@@ -0,0 +1,71 @@
+#include "frame_bounds.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+
+    void centerOnBox(Bounds &bounds)
+    {
+        for (int k = 0; k < 3; k++)
+            bounds.center[k] = (bounds.min[k] + bounds.max[k]) * 0.5f;
+    }
+
+    float distance(const float *a, const float *b)
+    {
+        float x = a[0] - b[0], y = a[1] - b[1], z = a[2] - b[2];
+        return std::sqrt(x * x + y * y + z * z);
+    }
+}
+
+std::vector<Bounds> buildFrameBounds(const FrameView<const Vertex> &frames)
+{
+    std::vector<Bounds> bounds(frames.frameCount());
+    for (size_t f = 0; f < frames.frameCount(); f++) {
+        Bounds &frame = bounds[f];
+        std::fill(frame.min, frame.min + 3, FLT_MAX);
+        std::fill(frame.max, frame.max + 3, -FLT_MAX);
+        const Vertex *vertices = frames[f];
+        for (size_t i = 0; i < frames.vertexCount(); i++) {
+            for (int k = 0; k < 3; k++) {
+                frame.min[k] = std::min(frame.min[k], vertices[i].coords[k]);
+                frame.max[k] = std::max(frame.max[k], vertices[i].coords[k]);
+            }
+        }
+        if (frames.vertexCount() == 0) {
+            std::fill(frame.min, frame.min + 3, 0.0f);
+            std::fill(frame.max, frame.max + 3, 0.0f);
+        }
+
+        // the box center is within a few percent of the smallest sphere for a standing character
+        // and needs no second pass to find
+        centerOnBox(frame);
+        frame.radius = 0.0f;
+        for (size_t i = 0; i < frames.vertexCount(); i++)
+            frame.radius = std::max(frame.radius, distance(vertices[i].coords, frame.center));
+    }
+    return bounds;
+}
+
+std::vector<Bounds> buildClipBounds(const std::vector<Bounds> &frameBounds, const std::vector<AnimationClip> &clips)
+{
+    std::vector<Bounds> bounds(clips.size());
+    for (size_t c = 0; c < clips.size(); c++) {
+        Bounds &clip = bounds[c];
+        clip = frameBounds[clips[c].start];
+        for (int f = clips[c].start + 1; f <= clips[c].end; f++) {
+            for (int k = 0; k < 3; k++) {
+                clip.min[k] = std::min(clip.min[k], frameBounds[f].min[k]);
+                clip.max[k] = std::max(clip.max[k], frameBounds[f].max[k]);
+            }
+        }
+
+        // the sphere around the union box center that holds every frame sphere
+        centerOnBox(clip);
+        clip.radius = 0.0f;
+        for (int f = clips[c].start; f <= clips[c].end; f++)
+            clip.radius = std::max(clip.radius, distance(frameBounds[f].center, clip.center) + frameBounds[f].radius);
+    }
+    return bounds;
+}
@@ -1,5 +1,5 @@
 #include <iostream>
-#include <fstream>
+#include <cstring>
 
 #include "glad/glad.h"
 #include "KHR/khrplatform.h"
@@ -9,10 +9,19 @@
 #include "camera.h"
 #include "shader_strings.h"
 #include "MD2.h"
+#include "md2_model.h"
+#include "mesh_optimizer.h"
+#include "frame_stats.h"
+#include "animation.h"
+#include "frame_bounds.h"
 
 #define resource(name) DATA#name
 
 #include <vector>
+#include <string>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
 
 void error_callback(int error, const char *description);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
@@ -40,18 +49,18 @@ enum VBO {
     DOT,
     OBJ_VBO,
     OBJ_UV_VBO,
+    OBJ_EBO,
+    CROWD_VBO,
+    CROWD_FRAME_VBO,
+    FRAME_TABLE_VBO,
+    NORMAL_VBO,
     VBO_NUMBER
 };
 
 GLuint vaos[VAO_NUMBER], vbos[VBO_NUMBER];
 
 
-std::vector<Frame> frames;
-std::vector<std::vector<TriangleVertex>> triangleVertices;
-std::vector<MeshUV> uvs;
-std::vector<Vertex> vertices;
-std::vector<std::vector<Vertex>> frameVertices;
-std::vector<VertexUV> sts;
+MD2Model md2Model;
 
 const int WIDTH = 800;
 const int HEIGHT = 600;
@@ -60,10 +69,22 @@ GLFWwindow *window;
 GLuint program;
 GLuint skyProgram;
 GLuint mapProgram;
+GLuint animProgram;
+GLuint quantProgram;
+GLuint crowdProgram;
+GLuint crowdQuantProgram;
+GLuint crowdTextureProgram;
+GLuint impostorProgram;
 GLuint cubemapTexture;
 
 bool thirdPerson = true;
 bool isStand = true;
+bool interpolate = true;
+// keep frames on the gpu as the raw 8 bit md2 vertices, dequantized in quantVShader
+bool compactFrames = true;
+// build the mesh from the md2 gl commands as a strip list with primitive restart instead of the
+// triangle list
+bool glCommandStrips = false;
 GLint modelLoc, viewLoc, projLoc;
 
 // Camera
@@ -74,7 +95,63 @@ bool firstMouse = true;
 GLfloat deltaTime = 0.0f;
 GLfloat lastFrame = 0.0f;
 
+// seconds each animation frame is shown
+const float FRAME_TIME = 0.15f;
+
+// the clips of the md2 and the animation of every character, the player is instance 0 and the
+// crowd follows it
+std::vector<AnimationClip> clips;
+AnimationPlayer animation;
+
+// benchmark crowd, extra characters drawn on a grid over the floor with one instanced draw, the
+// larger sizes are the stress test for sizing crowd scenes
+const int CROWD_SIZES[] = {0, 16, 64, 256, 1024, 2048, 4096, 10000};
+int crowdSize = 0;
+std::vector<glm::mat4> crowd;
+FrameStats frameStats;
+
+// where the crowd reads its frames from, the buffer textures of the animation buffer, the vertex
+// animation texture, or the player's path of one draw per character re-pointing the attributes
+enum CrowdPath { CROWD_BUFFER_TEXTURE, CROWD_ANIMATION_TEXTURE, CROWD_PER_DRAW, CROWD_PATH_COUNT };
+const char *CROWD_PATH_NAMES[CROWD_PATH_COUNT] = {"buffer texture", "animation texture", "draw per character"};
+int crowdPath = CROWD_BUFFER_TEXTURE;
+
+// draw the crowd at the level of detail that fits its size on screen
+bool levelOfDetail = true;
+// a character drawn at least LOD_HEIGHTS[i] pixels high stays below level i + 1
+const float LOD_HEIGHTS[LOD_LEVELS] = {120.0f, 60.0f, 30.0f};
+// bounding sphere of the character over all frames, around its origin and in world units
+float characterRadius = 0.0f;
+// the crowd sorted by level every frame, the model matrices and the frames, next frames and blends
+// back to back, level i starts at instance levelStarts[i], the impostors come last
+std::vector<glm::mat4> crowdByLevel;
+std::vector<float> crowdAnimation;
+
+// crowd members drawn less than IMPOSTOR_HEIGHT pixels high are quads from the impostor atlas, sorted
+// into the level after the meshes
+bool impostors = true;
+const float IMPOSTOR_HEIGHT = 40.0f;
+const int IMPOSTOR_LEVEL = LOD_LEVELS + 1;
+// views per side of an atlas layer and pixels per view
+const int IMPOSTOR_GRID = 8;
+const int IMPOSTOR_CELL = 32;
+size_t levelStarts[IMPOSTOR_LEVEL + 2];
+
+// leave out crowd members outside the view or further away than CULL_DISTANCE
+bool crowdCulling = true;
+const float CULL_DISTANCE = 40.0f;
+// model space bounds of every frame and of every clip, the clip every crowd member plays and how
+// many were left out this frame
+std::vector<Bounds> frameBounds;
+std::vector<Bounds> clipBounds;
+std::vector<int> crowdClips;
+size_t culledCount = 0;
+
 void do_movement();
+void buildCrowd(int size);
+void sortCrowd(const glm::mat4 &view, const glm::mat4 &projection);
+// model space direction the view in column x, row y of the impostor atlas looks from
+glm::vec3 impostorDirection(int x, int y);
 
 
 void init();
@@ -131,80 +208,36 @@ int main() {
     }
 
     // model load code ...
-    std::ifstream md2File(resource(tris.md2), std::ios_base::binary);
-    if (!md2File) {
-        std::cerr << "load model failure" << std::endl;
+    if (!loadMD2(resource(tris.md2), md2Model, glCommandStrips)) {
         exit(-1);
     }
 
-    MD2 md2;
-    md2File.read(reinterpret_cast<char *>(&md2), sizeof(md2));
-    std::string magic(reinterpret_cast<char *>(&md2.magic), 4);
-    if (magic != "IDP2") {
-        std::cerr << "not MD2 model" << std::endl;
-        exit(-1);
+    {
+        const MeshStats &stats = md2Model.stats;
+        std::cout << "vertex cache: ACMR " << stats.acmrBefore << " -> " << stats.acmrAfter
+                  << ", ATVR " << stats.atvrBefore << " -> " << stats.atvrAfter << std::endl;
+        std::cout << "triangle list: " << stats.listIndices << " indices, " << stats.listIndices * sizeof(GLushort)
+                  << " bytes, " << stats.listVertices << " vertices" << std::endl;
+        std::cout << "strip list: " << stats.stripIndices << " indices, " << stats.stripIndices * sizeof(GLushort)
+                  << " bytes, " << stats.stripVertices << " vertices, " << stats.strips << " strips, ACMR "
+                  << stats.stripAcmr << std::endl;
     }
 
-    md2File.seekg(md2.offsetFrames, md2File.beg);
-    for (int i = 0; i < md2.numFrames; i++) {
-        Frame frame;
-        md2File.read(reinterpret_cast<char *>(&frame), sizeof(frame));
-        frames.push_back(frame);
-
-        std::vector<TriangleVertex> vertices;
-        vertices.push_back(frame.vertices[0]);
-        for (int i = 1; i < md2.numVertices; i++) {
-            TriangleVertex triangleVertex;
-            md2File.read(reinterpret_cast<char *>(&triangleVertex), sizeof(triangleVertex));
-            vertices.push_back(triangleVertex);
-        }
-        triangleVertices.push_back(vertices);
-    }
-
-    md2File.seekg(md2.offsetTexCoords, md2File.beg);
-    for (size_t i = 0; i < md2.numTexCoords; i++) {
-        MeshUV meshUV;
-        md2File.read(reinterpret_cast<char *>(&meshUV), sizeof(meshUV));
-        uvs.push_back(meshUV);
-    }
-
-    for (size_t p = 0; p < frames.size(); p++) {
-        for (size_t i = 0; i < triangleVertices[p].size(); i++) {
-            Vertex vertex;
-            vertex.coords[0] = triangleVertices[p][i].vertex[0] * frames[p].scale[0] +
-                                   frames[p].translate[0];
-            vertex.coords[1] = triangleVertices[p][i].vertex[2] * frames[p].scale[2] +
-                               frames[p].translate[2];
-            vertex.coords[2] = triangleVertices[p][i].vertex[1] * frames[p].scale[1] +
-                               frames[p].translate[1];
-            vertices.push_back(vertex);
-        }
-
-
-        std::vector<Vertex> frameVertex;
-        md2File.seekg(md2.offsetTriangles, md2File.beg);
-        for (size_t i = 0; i < md2.numTriangles; i++) {
-            Mesh mesh;
-            md2File.read(reinterpret_cast<char *>(&mesh), sizeof(mesh));
-            for (size_t k = 0; k < 3; k++) {
-                frameVertex.push_back(vertices[mesh.meshIndex[k]]);
-
-                VertexUV uv;
-                uv.st[0] = uvs[mesh.stIndex[k]].s / (float) md2.skinWidth;
-                uv.st[1] = uvs[mesh.stIndex[k]].t / (float) md2.skinWidth;
-                sts.push_back(uv);
-            }
-        }
-        vertices.clear();
-        frameVertices.push_back(frameVertex);
+    clips = buildClips(md2Model.view, 1.0f / FRAME_TIME);
+    for (const AnimationClip &clip : clips) {
+        std::cout << "clip " << clip.name << ": frames " << clip.start << " - " << clip.end << std::endl;
     }
-
-    for (size_t i = 0; i < frames.size(); i++) {
-        std::cout << i << " " << frames[i].name << std::endl;
+    frameBounds = buildFrameBounds(md2Model.baked.frames());
+    clipBounds = buildClipBounds(frameBounds, clips);
+    const AnimationClip *standClip = findClip(clips, "stand");
+    const AnimationClip *runClip = findClip(clips, "run");
+    if (!standClip || !runClip) {
+        std::cerr << "model has no stand or run animation" << std::endl;
+        exit(-1);
     }
+    const AnimationClip *playerClip = standClip;
+    animation.add(*playerClip);
 
-    std::cout << frameVertices[0][100].coords[0] << std::endl;
-    std::cout << frameVertices[45][100].coords[0] << std::endl;
     // end model load
     // some callback
     glfwSetKeyCallback(window, key_callback);
@@ -311,11 +344,228 @@ int main() {
 
     glBindVertexArray(vaos[OBJ]);
 
+    // the baked streams are already in their final layout, they go to the gpu straight from the mapping
+    const BakedMD2 &baked = md2Model.baked;
     glBindBuffer(GL_ARRAY_BUFFER, vbos[OBJ_UV_VBO]);
-    glBufferData(GL_ARRAY_BUFFER, sts.size() * sizeof(VertexUV), sts.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, baked.vertexCount() * sizeof(VertexUV), baked.sts(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
+    // every level of detail in one index buffer, the full mesh first
+    GLsizeiptr levelOffsets[LOD_LEVELS + 2] = {0};
+    for (int level = 0; level <= LOD_LEVELS; level++)
+        levelOffsets[level + 1] = levelOffsets[level] + baked.levelIndexCount(level) * sizeof(GLushort);
+    std::vector<GLushort> levelIndices;
+    for (int level = 0; level <= LOD_LEVELS; level++) {
+        const GLushort *indices = baked.levelIndices(level);
+        levelIndices.insert(levelIndices.end(), indices, indices + baked.levelIndexCount(level));
+        std::cout << "level of detail " << level << ": " << baked.levelIndexCount(level) << " indices" << std::endl;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos[OBJ_EBO]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, levelIndices.size() * sizeof(GLushort), levelIndices.data(), GL_STATIC_DRAW);
+    for (size_t i = 0; i < baked.frames().size(); i++) {
+        const GLfloat *coords = baked.frames().data()[i].coords;
+        characterRadius = std::max(characterRadius, glm::length(glm::vec3(coords[0], coords[1], coords[2])));
+    }
+    characterRadius *= 0.03f;
+
+    // every animation frame stays on the gpu, a draw picks its frame by re-pointing the
+    // position attributes, the indices and uvs are the same for all frames
+    GLsizei frameVertexCount = baked.vertexCount();
+    GLsizeiptr frameStride;
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[OBJ_VBO]);
+    if (compactFrames) {
+        frameStride = frameVertexCount * sizeof(TriangleVertex);
+        glBufferData(GL_ARRAY_BUFFER, baked.frameCount() * frameStride, baked.quantizedFrames().data(),
+                     GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(TriangleVertex), 0);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(TriangleVertex), 0);
+    } else {
+        frameStride = frameVertexCount * sizeof(Vertex);
+        glBufferData(GL_ARRAY_BUFFER, baked.frameCount() * frameStride, baked.frames().data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        // next frame for the interpolated path
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    }
+
+    // the packed normals of every frame, picked by the same frame offsets as the positions
+    GLsizeiptr normalStride = frameVertexCount * sizeof(GLuint);
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[NORMAL_VBO]);
+    glBufferData(GL_ARRAY_BUFFER, baked.frameCount() * normalStride, baked.normals().data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(10);
+    glVertexAttribPointer(10, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 0, 0);
+    glEnableVertexAttribArray(11);
+    glVertexAttribPointer(11, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 0, 0);
+    std::cout << "animation buffer: " << md2Model.view.frameCount() * frameStride / 1024 << " KB"
+              << (compactFrames ? " (compact)" : "") << ", normals "
+              << md2Model.view.frameCount() * normalStride / 1024 << " KB, " << frameVertexCount << " vertices, "
+              << md2Model.view.triangleCount() << " triangles" << std::endl;
+
+    // the crowd shaders fetch their frames from the same buffer through a buffer texture, the
+    // compact frames also need the scale and translate of every frame
+    GLint maxTexels;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (baked.frameCount() * frameVertexCount > maxTexels) {
+        std::cerr << "animation buffer is larger than a buffer texture, the crowd can't be drawn" << std::endl;
+    }
+    GLuint frameTexture, frameTableTexture, normalTexture;
+    glGenTextures(1, &frameTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, frameTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, compactFrames ? GL_RGBA8UI : GL_RGB32F, vbos[OBJ_VBO]);
+    // 10:10:10:2 isn't a buffer texture format, the shaders unpack the bits themselves
+    glGenTextures(1, &normalTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, normalTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, vbos[NORMAL_VBO]);
+
+    std::vector<GLfloat> frameTable;
+    for (int i = 0; i < md2Model.view.frameCount(); i++) {
+        const Frame &frame = *md2Model.view.frame(i);
+        frameTable.insert(frameTable.end(), frame.scale, frame.scale + 3);
+        frameTable.push_back(0.0f);
+        frameTable.insert(frameTable.end(), frame.translate, frame.translate + 3);
+        frameTable.push_back(0.0f);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, vbos[FRAME_TABLE_VBO]);
+    glBufferData(GL_TEXTURE_BUFFER, frameTable.size() * sizeof(GLfloat), frameTable.data(), GL_STATIC_DRAW);
+    glGenTextures(1, &frameTableTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, frameTableTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, vbos[FRAME_TABLE_VBO]);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // the vertex animation texture, every frame a row of half float positions and the normals in a
+    // second texture with the same layout, texelFetch only so nothing is filtered
+    GLint maxTextureSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (frameVertexCount > maxTextureSize || baked.frameCount() > maxTextureSize) {
+        std::cerr << "animation texture is larger than a texture, the crowd can't be drawn from it" << std::endl;
+    }
+    GLuint animationTexture, animationNormalTexture;
+    glGenTextures(1, &animationTexture);
+    glBindTexture(GL_TEXTURE_2D, animationTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, frameVertexCount, baked.frameCount(), 0, GL_RGB, GL_FLOAT,
+                 baked.frames().data());
+    glGenTextures(1, &animationNormalTexture);
+    glBindTexture(GL_TEXTURE_2D, animationNormalTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, frameVertexCount, baked.frameCount(), 0, GL_RED_INTEGER,
+                 GL_UNSIGNED_INT, baked.normals().data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    std::cout << "animation texture: " << frameVertexCount << " x " << baked.frameCount() << ", "
+              << baked.frames().size() * 3 * sizeof(GLushort) / 1024 << " KB" << std::endl;
+
+    // the model matrices and the frame, next frame and blend arrays of the crowd are streamed in
+    // every frame sorted by level of detail, each level's draw points the attributes at its part
+    glBindBuffer(GL_ARRAY_BUFFER, vbos[CROWD_VBO]);
+    for (int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid *)(i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(3 + i, 1);
+    }
+    for (int i = 7; i < 10; i++) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+
+    GLenum objMode = GL_TRIANGLES;
+    if (md2Model.strips) {
+        objMode = GL_TRIANGLE_STRIP;
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(PRIMITIVE_RESTART);
+    }
+
+    // the impostor atlas, every frame drawn once from each view into its own layer. One sphere
+    // around all frames keeps the quads the same size whatever the frame.
+    AnimationClip allFrames = {"all", 0, baked.frameCount() - 1, 0.0f};
+    Bounds impostorBounds = buildClipBounds(frameBounds, std::vector<AnimationClip>(1, allFrames))[0];
+    GLint impostorSize = IMPOSTOR_GRID * IMPOSTOR_CELL;
+    GLuint impostorTexture, impostorFramebuffer, impostorDepth;
+    glGenTextures(1, &impostorTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, impostorTexture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // below 8 pixels a view would bleed into its neighbours
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 2);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, impostorSize, impostorSize, baked.frameCount(), 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, NULL);
+    glGenRenderbuffers(1, &impostorDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, impostorDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, impostorSize, impostorSize);
+    glGenFramebuffers(1, &impostorFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, impostorFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, impostorDepth);
+
+    // drawn through the animation texture as a single instance, the instance arrays are switched
+    // off for it so the constant attributes below are used
+    glUseProgram(crowdTextureProgram);
+    glUniform1i(glGetUniformLocation(crowdTextureProgram, "frames"), 1);
+    glUniform1i(glGetUniformLocation(crowdTextureProgram, "normals"), 3);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, animationTexture);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, animationNormalTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture_obj);
+    for (int i = 3; i < 10; i++)
+        glDisableVertexAttribArray(i);
+    for (int i = 0; i < 4; i++)
+        glVertexAttrib4f(3 + i, i == 0, i == 1, i == 2, i == 3);
+    glVertexAttrib1f(9, 0.0f);
+
+    GLint viewport[4];
+    GLfloat clearColor[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 boundsCenter(impostorBounds.center[0], impostorBounds.center[1], impostorBounds.center[2]);
+    float boundsRadius = impostorBounds.radius;
+    glm::mat4 impostorProjection = glm::ortho(-boundsRadius, boundsRadius, -boundsRadius, boundsRadius,
+                                              boundsRadius, 3.0f * boundsRadius);
+    glUniformMatrix4fv(glGetUniformLocation(crowdTextureProgram, "projection"), 1, GL_FALSE,
+                       &impostorProjection[0][0]);
+    GLint impostorViewLoc = glGetUniformLocation(crowdTextureProgram, "view");
+    for (int f = 0; f < baked.frameCount(); f++) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, impostorTexture, 0, f);
+        if (f == 0 && glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "impostor framebuffer is incomplete" << std::endl;
+        glViewport(0, 0, impostorSize, impostorSize);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glVertexAttrib1f(7, f);
+        glVertexAttrib1f(8, f);
+        for (int y = 0; y < IMPOSTOR_GRID; y++) {
+            for (int x = 0; x < IMPOSTOR_GRID; x++) {
+                // the same view impostorVShader picks, looking at the sphere from twice its radius
+                glm::vec3 look = impostorDirection(x, y);
+                glm::vec3 up = std::abs(look.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                glm::mat4 impostorView = glm::lookAt(boundsCenter + look * (2.0f * boundsRadius), boundsCenter, up);
+                glUniformMatrix4fv(impostorViewLoc, 1, GL_FALSE, &impostorView[0][0]);
+                glViewport(x * IMPOSTOR_CELL, y * IMPOSTOR_CELL, IMPOSTOR_CELL, IMPOSTOR_CELL);
+                glDrawElements(objMode, baked.indexCount(), GL_UNSIGNED_SHORT, 0);
+            }
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, impostorTexture);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &impostorFramebuffer);
+    glDeleteRenderbuffers(1, &impostorDepth);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    for (int i = 3; i < 10; i++)
+        glEnableVertexAttribArray(i);
+    std::cout << "impostor atlas: " << baked.frameCount() << " layers of " << IMPOSTOR_GRID << " x " << IMPOSTOR_GRID
+              << " views, " << baked.frameCount() * impostorSize * impostorSize * 4 / 1024 << " KB" << std::endl;
+
     glBindVertexArray(0);
 
     GLuint wallTexture, floorTexture;
@@ -348,15 +598,11 @@ int main() {
     glBindTexture(GL_TEXTURE_2D, 0);
 
 
-    int f = 0;
-    float d_time = 0;
-
     while (!glfwWindowShouldClose(window)) {
         // Set frame time
         GLfloat currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
-        d_time += deltaTime;
 
         do_movement();
 
@@ -437,27 +683,151 @@ int main() {
             model = glm::translate(model, glm::vec3(0.0f, 1.3f, 0.0f));
 			model = glm::rotate(model, glm::radians(camera.Yaw), glm::vec3(0.0f, -1.0f, 0.0f));
             model = glm::scale(model, glm::vec3(0.03f, 0.03f, 0.03f));
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &model[0][0]);
             glBindTexture(GL_TEXTURE_2D, texture_obj);
-			if (isStand) {
-				if (f > 39) f = 0;
-			}
-			else
-			{
-				if (f > 45 || f < 40) f = 40;
-			}
-			
-            glBindBuffer(GL_ARRAY_BUFFER, vbos[OBJ_VBO]);
-            glBufferData(GL_ARRAY_BUFFER, frameVertices[f].size() * sizeof(Vertex), frameVertices[f].data(),
-                         GL_STATIC_DRAW);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-            glDrawArrays(GL_TRIANGLES, 0, frameVertices[f].size());
-            if (d_time > 0.15) {
-                f++;
-                d_time = 0;
+            if (playerClip != (isStand ? standClip : runClip)) {
+                playerClip = isStand ? standClip : runClip;
+                animation.play(0, *playerClip);
+            }
+            animation.update(deltaTime, interpolate);
+
+            // the frame blended towards, all frames are already on the gpu so only the attribute
+            // offsets move
+            int f = static_cast<int>(animation.frames()[0]);
+            int next = static_cast<int>(animation.nextFrames()[0]);
+            float blend = animation.blends()[0];
+
+            // the snapping path needs the normals too, without interpolate next is f and blend zero
+            GLuint characterProgram = compactFrames ? quantProgram : animProgram;
+            glUseProgram(characterProgram);
+            GLint objModelLoc = glGetUniformLocation(characterProgram, "model");
+            GLint blendLoc = glGetUniformLocation(characterProgram, "blend");
+            glUniformMatrix4fv(glGetUniformLocation(characterProgram, "view"), 1, GL_FALSE, &view[0][0]);
+            glUniformMatrix4fv(glGetUniformLocation(characterProgram, "projection"), 1, GL_FALSE, &projection[0][0]);
+            GLint scaleLoc = glGetUniformLocation(characterProgram, "scale");
+            GLint translateLoc = glGetUniformLocation(characterProgram, "translate");
+            GLint nextScaleLoc = glGetUniformLocation(characterProgram, "nextScale");
+            GLint nextTranslateLoc = glGetUniformLocation(characterProgram, "nextTranslate");
+
+            // one character at one level of detail, the frames are picked by the attribute offsets
+            auto drawCharacter = [&](const glm::mat4 &model, int f, int next, float blend, int level) {
+                glUniformMatrix4fv(objModelLoc, 1, GL_FALSE, &model[0][0]);
+                glUniform1f(blendLoc, blend);
+                glBindBuffer(GL_ARRAY_BUFFER, vbos[OBJ_VBO]);
+                if (compactFrames) {
+                    glUniform3fv(scaleLoc, 1, md2Model.view.frame(f)->scale);
+                    glUniform3fv(translateLoc, 1, md2Model.view.frame(f)->translate);
+                    glUniform3fv(nextScaleLoc, 1, md2Model.view.frame(next)->scale);
+                    glUniform3fv(nextTranslateLoc, 1, md2Model.view.frame(next)->translate);
+                    glVertexAttribPointer(0, 3, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(TriangleVertex),
+                                          (GLvoid *)(f * frameStride));
+                    glVertexAttribPointer(2, 3, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(TriangleVertex),
+                                          (GLvoid *)(next * frameStride));
+                } else {
+                    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid *)(f * frameStride));
+                    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid *)(next * frameStride));
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, vbos[NORMAL_VBO]);
+                glVertexAttribPointer(10, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 0, (GLvoid *)(f * normalStride));
+                glVertexAttribPointer(11, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 0, (GLvoid *)(next * normalStride));
+                glDrawElements(level == 0 ? objMode : GL_TRIANGLES, md2Model.baked.levelIndexCount(level),
+                               GL_UNSIGNED_SHORT, (GLvoid *)levelOffsets[level]);
+            };
+            drawCharacter(model, f, next, blend, 0);
+
+            if (!crowd.empty()) {
+                sortCrowd(view, projection);
+                size_t count = levelStarts[IMPOSTOR_LEVEL + 1];
+                GLsizeiptr arraySize = count * sizeof(float);
+                glBindBuffer(GL_ARRAY_BUFFER, vbos[CROWD_VBO]);
+                glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), crowdByLevel.data(), GL_STREAM_DRAW);
+                glBindBuffer(GL_ARRAY_BUFFER, vbos[CROWD_FRAME_VBO]);
+                glBufferData(GL_ARRAY_BUFFER, 3 * arraySize, crowdAnimation.data(), GL_STREAM_DRAW);
+
+                // glDrawElementsInstancedBaseInstance isn't there on 4.1 so the instance attributes
+                // are pointed at the part of the level drawn instead
+                auto pointInstances = [&](size_t start) {
+                    glBindBuffer(GL_ARRAY_BUFFER, vbos[CROWD_VBO]);
+                    for (int i = 0; i < 4; i++) {
+                        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                              (GLvoid *)(start * sizeof(glm::mat4) + i * sizeof(glm::vec4)));
+                    }
+                    glBindBuffer(GL_ARRAY_BUFFER, vbos[CROWD_FRAME_VBO]);
+                    for (int i = 0; i < 3; i++) {
+                        glVertexAttribPointer(7 + i, 1, GL_FLOAT, GL_FALSE, 0,
+                                              (GLvoid *)(i * arraySize + start * sizeof(float)));
+                    }
+                };
+
+                if (crowdPath == CROWD_PER_DRAW) {
+                    for (int level = 0; level <= LOD_LEVELS; level++) {
+                        for (size_t i = levelStarts[level]; i < levelStarts[level + 1]; i++) {
+                            drawCharacter(crowdByLevel[i], static_cast<int>(crowdAnimation[i]),
+                                          static_cast<int>(crowdAnimation[count + i]), crowdAnimation[2 * count + i],
+                                          level);
+                        }
+                    }
+                } else {
+                    GLuint instancedProgram = compactFrames ? crowdQuantProgram : crowdProgram;
+                    if (crowdPath == CROWD_ANIMATION_TEXTURE)
+                        instancedProgram = crowdTextureProgram;
+                    glUseProgram(instancedProgram);
+                    glUniformMatrix4fv(glGetUniformLocation(instancedProgram, "view"), 1, GL_FALSE, &view[0][0]);
+                    glUniformMatrix4fv(glGetUniformLocation(instancedProgram, "projection"), 1, GL_FALSE,
+                                       &projection[0][0]);
+                    glUniform1i(glGetUniformLocation(instancedProgram, "vertexCount"), md2Model.baked.vertexCount());
+                    glUniform1i(glGetUniformLocation(instancedProgram, "frames"), 1);
+                    glUniform1i(glGetUniformLocation(instancedProgram, "frameTable"), 2);
+                    glUniform1i(glGetUniformLocation(instancedProgram, "normals"), 3);
+                    if (crowdPath == CROWD_ANIMATION_TEXTURE) {
+                        glActiveTexture(GL_TEXTURE1);
+                        glBindTexture(GL_TEXTURE_2D, animationTexture);
+                        glActiveTexture(GL_TEXTURE3);
+                        glBindTexture(GL_TEXTURE_2D, animationNormalTexture);
+                    } else {
+                        glActiveTexture(GL_TEXTURE1);
+                        glBindTexture(GL_TEXTURE_BUFFER, frameTexture);
+                        glActiveTexture(GL_TEXTURE2);
+                        glBindTexture(GL_TEXTURE_BUFFER, frameTableTexture);
+                        glActiveTexture(GL_TEXTURE3);
+                        glBindTexture(GL_TEXTURE_BUFFER, normalTexture);
+                    }
+                    glActiveTexture(GL_TEXTURE0);
+
+                    // one instanced draw per level
+                    for (int level = 0; level <= LOD_LEVELS; level++) {
+                        size_t start = levelStarts[level];
+                        size_t levelCount = levelStarts[level + 1] - start;
+                        if (levelCount == 0)
+                            continue;
+                        pointInstances(start);
+                        glDrawElementsInstanced(level == 0 ? objMode : GL_TRIANGLES,
+                                                md2Model.baked.levelIndexCount(level), GL_UNSIGNED_SHORT,
+                                                (GLvoid *)levelOffsets[level], levelCount);
+                    }
+                }
+
+                // and every impostor in one more, four corners each
+                size_t impostorCount = levelStarts[IMPOSTOR_LEVEL + 1] - levelStarts[IMPOSTOR_LEVEL];
+                if (impostorCount > 0) {
+                    glm::vec3 eye(glm::inverse(view)[3]);
+                    glUseProgram(impostorProgram);
+                    glUniformMatrix4fv(glGetUniformLocation(impostorProgram, "view"), 1, GL_FALSE, &view[0][0]);
+                    glUniformMatrix4fv(glGetUniformLocation(impostorProgram, "projection"), 1, GL_FALSE,
+                                       &projection[0][0]);
+                    glUniform3f(glGetUniformLocation(impostorProgram, "eye"), eye.x, eye.y, eye.z);
+                    glUniform4f(glGetUniformLocation(impostorProgram, "bounds"), boundsCenter.x, boundsCenter.y,
+                                boundsCenter.z, boundsRadius);
+                    glUniform1i(glGetUniformLocation(impostorProgram, "grid"), IMPOSTOR_GRID);
+                    glUniform1i(glGetUniformLocation(impostorProgram, "impostors"), 4);
+                    glActiveTexture(GL_TEXTURE4);
+                    glBindTexture(GL_TEXTURE_2D_ARRAY, impostorTexture);
+                    glActiveTexture(GL_TEXTURE0);
+                    pointInstances(levelStarts[IMPOSTOR_LEVEL]);
+                    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, impostorCount);
+                }
             }
+
+            glUseProgram(program);
             glBindVertexArray(0);
         }
 
@@ -485,6 +855,21 @@ int main() {
         glBindVertexArray(0);
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (!crowd.empty()) {
+            std::string levels;
+            for (int level = 0; level <= LOD_LEVELS; level++)
+                levels += (level ? "/" : "") + std::to_string(levelStarts[level + 1] - levelStarts[level]);
+            size_t impostorCount = levelStarts[IMPOSTOR_LEVEL + 1] - levelStarts[IMPOSTOR_LEVEL];
+            frameStats.add(deltaTime, std::to_string(crowd.size() + 1) + " characters, " +
+                                      CROWD_PATH_NAMES[crowdPath] +
+                                      (compactFrames && crowdPath != CROWD_ANIMATION_TEXTURE ? " compact" : "") +
+                                      (glCommandStrips ? " strips" : "") +
+                                      (interpolate ? " interpolated" : " per frame") +
+                                      (levelOfDetail ? ", levels " + levels : "") +
+                                      (impostors ? ", " + std::to_string(impostorCount) + " impostors" : "") +
+                                      (crowdCulling ? ", " + std::to_string(culledCount) + " culled" : ""));
+        }
     }
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -542,6 +927,30 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     if (action == GLFW_PRESS && key == GLFW_KEY_P) {
         thirdPerson = !thirdPerson;
     }
+    if (action == GLFW_PRESS && key == GLFW_KEY_I) {
+        interpolate = !interpolate;
+        frameStats.reset();
+    }
+    if (action == GLFW_PRESS && key == GLFW_KEY_B) {
+        crowdSize = (crowdSize + 1) % (sizeof(CROWD_SIZES) / sizeof(CROWD_SIZES[0]));
+        buildCrowd(CROWD_SIZES[crowdSize]);
+    }
+    if (action == GLFW_PRESS && key == GLFW_KEY_V) {
+        crowdPath = (crowdPath + 1) % CROWD_PATH_COUNT;
+        frameStats.reset();
+    }
+    if (action == GLFW_PRESS && key == GLFW_KEY_C) {
+        crowdCulling = !crowdCulling;
+        frameStats.reset();
+    }
+    if (action == GLFW_PRESS && key == GLFW_KEY_O) {
+        impostors = !impostors;
+        frameStats.reset();
+    }
+    if (action == GLFW_PRESS && key == GLFW_KEY_L) {
+        levelOfDetail = !levelOfDetail;
+        frameStats.reset();
+    }
 	
 }
 
@@ -589,6 +998,135 @@ void do_movement()
 		camera.ProcessKeyboard(RIGHT, deltaTime);
 }
 
+void buildCrowd(int size)
+{
+    crowd.clear();
+    crowdClips.clear();
+    animation.resize(1);
+    frameStats.reset();
+    // no vsync while benchmarking so the frame time is not capped
+    glfwSwapInterval(size > 0 ? 0 : 1);
+
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(size))));
+    float spacing = side > 0 ? 20.0f / side : 0.0f;
+    for (int i = 0; i < size; i++) {
+        glm::mat4 model;
+        model = glm::translate(model, glm::vec3(-10.0f + spacing * (i % side + 0.5f), 1.3f,
+                                                -10.0f + spacing * (i / side + 0.5f)));
+        model = glm::scale(model, glm::vec3(0.03f, 0.03f, 0.03f));
+        crowd.push_back(model);
+
+        // every member plays one of the clips, a bit ahead of its neighbour so they don't move in step
+        animation.add(clips[i % clips.size()], i * 0.37f);
+        crowdClips.push_back(i % clips.size());
+    }
+    crowdByLevel.resize(crowd.size());
+    crowdAnimation.resize(3 * crowd.size());
+}
+
+glm::vec3 impostorDirection(int x, int y)
+{
+    // the hemisphere folded out into a diamond and turned 45 degrees to fill the square, like
+    // cellDirection in impostorVShader
+    float u = (x + 0.5f) / IMPOSTOR_GRID * 2.0f - 1.0f;
+    float v = (y + 0.5f) / IMPOSTOR_GRID * 2.0f - 1.0f;
+    float octX = (u + v) * 0.5f, octZ = (u - v) * 0.5f;
+    return glm::normalize(glm::vec3(octX, 1.0f - std::abs(octX) - std::abs(octZ), octZ));
+}
+
+// true when the sphere lies entirely on the outer side of plane
+bool outside(const glm::vec4 &plane, const glm::vec3 &center, float radius)
+{
+    return glm::dot(glm::vec3(plane), center) + plane.w < -radius;
+}
+
+// Whether crowd member i can be seen. The bounds of its clip reject it without looking at the frame,
+// past that it's only hidden when the spheres of both frames it blends between are outside the same
+// frustum plane.
+bool crowdVisible(size_t i, const glm::vec4 *planes, const glm::vec3 &eye)
+{
+    const glm::mat4 &model = crowd[i];
+    float scale = glm::length(glm::vec3(model[0]));
+    const Bounds &clip = clipBounds[crowdClips[i]];
+    glm::vec3 clipCenter(model * glm::vec4(clip.center[0], clip.center[1], clip.center[2], 1.0f));
+    float clipRadius = clip.radius * scale;
+    if (glm::distance(clipCenter, eye) - clipRadius > CULL_DISTANCE)
+        return false;
+    for (int p = 0; p < 6; p++) {
+        if (outside(planes[p], clipCenter, clipRadius))
+            return false;
+    }
+
+    // the crowd is instance 1 onwards of the animation player
+    const Bounds &current = frameBounds[static_cast<int>(animation.frames()[i + 1])];
+    const Bounds &next = frameBounds[static_cast<int>(animation.nextFrames()[i + 1])];
+    glm::vec3 currentCenter(model * glm::vec4(current.center[0], current.center[1], current.center[2], 1.0f));
+    glm::vec3 nextCenter(model * glm::vec4(next.center[0], next.center[1], next.center[2], 1.0f));
+    for (int p = 0; p < 6; p++) {
+        if (outside(planes[p], currentCenter, current.radius * scale) &&
+            outside(planes[p], nextCenter, next.radius * scale))
+            return false;
+    }
+    return true;
+}
+
+void sortCrowd(const glm::mat4 &view, const glm::mat4 &projection)
+{
+    // the frustum planes pointing inwards, taken from the rows of the view projection matrix
+    glm::mat4 viewProjection = projection * view;
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+    glm::vec4 planes[6];
+    for (int p = 0; p < 6; p++) {
+        planes[p] = p % 2 ? rows[3] - rows[p / 2] : rows[3] + rows[p / 2];
+        planes[p] /= glm::length(glm::vec3(planes[p]));
+    }
+    glm::vec3 eye(glm::inverse(view)[3]);
+
+    // the level goes by the height of the bounding sphere on screen, culled members get none
+    static std::vector<int> levels;
+    levels.resize(crowd.size());
+    size_t counts[IMPOSTOR_LEVEL + 1] = {0};
+    culledCount = 0;
+    for (size_t i = 0; i < crowd.size(); i++) {
+        if (crowdCulling && !crowdVisible(i, planes, eye)) {
+            levels[i] = -1;
+            culledCount++;
+            continue;
+        }
+        float depth = std::max(-(view * crowd[i][3]).z, 0.2f);
+        float height = characterRadius * projection[1][1] / depth * HEIGHT;
+        int level = 0;
+        if (impostors && height < IMPOSTOR_HEIGHT) {
+            level = IMPOSTOR_LEVEL;
+        } else if (levelOfDetail) {
+            while (level < LOD_LEVELS && height < LOD_HEIGHTS[level])
+                level++;
+        }
+        levels[i] = level;
+        counts[level]++;
+    }
+
+    levelStarts[0] = 0;
+    for (int level = 0; level <= IMPOSTOR_LEVEL; level++)
+        levelStarts[level + 1] = levelStarts[level] + counts[level];
+
+    // only the visible members are copied, the arrays are as long as there are of them
+    size_t next[IMPOSTOR_LEVEL + 1];
+    std::copy(levelStarts, levelStarts + IMPOSTOR_LEVEL + 1, next);
+    size_t count = levelStarts[IMPOSTOR_LEVEL + 1];
+    for (size_t i = 0; i < crowd.size(); i++) {
+        if (levels[i] < 0)
+            continue;
+        size_t slot = next[levels[i]]++;
+        crowdByLevel[slot] = crowd[i];
+        crowdAnimation[slot] = animation.frames()[i + 1];
+        crowdAnimation[count + slot] = animation.nextFrames()[i + 1];
+        crowdAnimation[2 * count + slot] = animation.blends()[i + 1];
+    }
+}
+
 void init()
 {
     GLuint vShader =  glCreateShader(GL_VERTEX_SHADER);
@@ -604,8 +1142,79 @@ void init()
     glAttachShader(program, fShader);
     glLinkProgram(program);
 
+    // the characters are lit by their md2 normals
+    GLuint litFShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(litFShader, 1, &glsl::litFShader, NULL);
+    glCompileShader(litFShader);
+
+    GLuint animVShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(animVShader, 1, &glsl::animVShader, NULL);
+    glCompileShader(animVShader);
+
+    animProgram = glCreateProgram();
+    glAttachShader(animProgram, animVShader);
+    glAttachShader(animProgram, litFShader);
+    glLinkProgram(animProgram);
+
+    GLuint quantVShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(quantVShader, 1, &glsl::quantVShader, NULL);
+    glCompileShader(quantVShader);
+
+    quantProgram = glCreateProgram();
+    glAttachShader(quantProgram, quantVShader);
+    glAttachShader(quantProgram, litFShader);
+    glLinkProgram(quantProgram);
+
+    GLuint crowdVShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(crowdVShader, 1, &glsl::crowdVShader, NULL);
+    glCompileShader(crowdVShader);
+
+    crowdProgram = glCreateProgram();
+    glAttachShader(crowdProgram, crowdVShader);
+    glAttachShader(crowdProgram, litFShader);
+    glLinkProgram(crowdProgram);
+
+    GLuint crowdQuantVShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(crowdQuantVShader, 1, &glsl::crowdQuantVShader, NULL);
+    glCompileShader(crowdQuantVShader);
+
+    crowdQuantProgram = glCreateProgram();
+    glAttachShader(crowdQuantProgram, crowdQuantVShader);
+    glAttachShader(crowdQuantProgram, litFShader);
+    glLinkProgram(crowdQuantProgram);
+
+    GLuint crowdTextureVShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(crowdTextureVShader, 1, &glsl::crowdTextureVShader, NULL);
+    glCompileShader(crowdTextureVShader);
+
+    crowdTextureProgram = glCreateProgram();
+    glAttachShader(crowdTextureProgram, crowdTextureVShader);
+    glAttachShader(crowdTextureProgram, litFShader);
+    glLinkProgram(crowdTextureProgram);
+
+    GLuint impostorVShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(impostorVShader, 1, &glsl::impostorVShader, NULL);
+    glCompileShader(impostorVShader);
+
+    GLuint impostorFShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(impostorFShader, 1, &glsl::impostorFShader, NULL);
+    glCompileShader(impostorFShader);
+
+    impostorProgram = glCreateProgram();
+    glAttachShader(impostorProgram, impostorVShader);
+    glAttachShader(impostorProgram, impostorFShader);
+    glLinkProgram(impostorProgram);
+
     glDeleteShader(vShader);
     glDeleteShader(fShader);
+    glDeleteShader(litFShader);
+    glDeleteShader(animVShader);
+    glDeleteShader(quantVShader);
+    glDeleteShader(crowdVShader);
+    glDeleteShader(crowdQuantVShader);
+    glDeleteShader(crowdTextureVShader);
+    glDeleteShader(impostorVShader);
+    glDeleteShader(impostorFShader);
 
     // for now just use it
     glUseProgram(program);
@@ -0,0 +1,124 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : mapping(NULL), length(0)
+#ifdef _WIN32
+        , file(INVALID_HANDLE_VALUE), fileMapping(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    this->close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) : MappedFile()
+{
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other)
+{
+    if (this != &other) {
+        this->close();
+        std::swap(this->mapping, other.mapping);
+        std::swap(this->length, other.length);
+#ifdef _WIN32
+        std::swap(this->file, other.file);
+        std::swap(this->fileMapping, other.fileMapping);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char *path)
+{
+    this->close();
+
+    this->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (this->file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(this->file, &size) || size.QuadPart == 0) {
+        this->close();
+        return false;
+    }
+
+    this->fileMapping = CreateFileMappingA(this->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!this->fileMapping) {
+        this->close();
+        return false;
+    }
+    this->mapping = static_cast<const char *>(MapViewOfFile(this->fileMapping, FILE_MAP_READ, 0, 0, 0));
+    if (!this->mapping) {
+        this->close();
+        return false;
+    }
+    this->length = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (this->mapping)
+        UnmapViewOfFile(this->mapping);
+    if (this->fileMapping)
+        CloseHandle(this->fileMapping);
+    if (this->file != INVALID_HANDLE_VALUE)
+        CloseHandle(this->file);
+    this->mapping = NULL;
+    this->length = 0;
+    this->fileMapping = NULL;
+    this->file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const char *path)
+{
+    this->close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // the mapping keeps its own reference to the file
+    void *mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    this->mapping = static_cast<const char *>(mapping);
+    this->length = status.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (this->mapping)
+        munmap(const_cast<char *>(this->mapping), this->length);
+    this->mapping = NULL;
+    this->length = 0;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "md2_bake.h"
+
+#include <cstring>
+
+namespace {
+
+    // true when count records of recordSize bytes starting at offset lie inside the data and the
+    // stream starts on the bake alignment
+    bool inside(size_t size, unsigned long long offset, unsigned long long count, size_t recordSize)
+    {
+        return offset % BAKE_ALIGNMENT == 0 && offset <= size && count * recordSize <= size - offset;
+    }
+}
+
+unsigned long long checksum(const char *data, size_t size)
+{
+    // eight bytes per step, a byte at a time would make the hash cost more than reading the bake
+    unsigned long long hash = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long word;
+        memcpy(&word, data + i, 8);
+        hash ^= word;
+        hash *= 1099511628211ULL;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool BakedMD2::open(const char *data, size_t size, size_t sourceSize, unsigned long long sourceChecksum,
+                    unsigned int flags)
+{
+    this->base = NULL;
+
+    // anything that doesn't match is simply a stale cache, the caller rebuilds it
+    if (size < sizeof(BakeHeader) || reinterpret_cast<size_t>(data) % 4 != 0)
+        return false;
+    const BakeHeader &header = *reinterpret_cast<const BakeHeader *>(data);
+    if (memcmp(header.magic, "BWMD", 4) != 0 || header.version != BAKE_VERSION ||
+        header.headerSize != sizeof(BakeHeader) || header.flags != flags || header.sourceSize != sourceSize ||
+        header.sourceChecksum != sourceChecksum || header.fileSize != size)
+        return false;
+
+    unsigned long long frameVertices = static_cast<unsigned long long>(header.frameCount) * header.vertexCount;
+    unsigned long long lodIndexCount = 0;
+    for (int level = 0; level < LOD_LEVELS; level++)
+        lodIndexCount += header.lodIndexCounts[level];
+    if (header.vertexCount > PRIMITIVE_RESTART ||
+        !inside(size, header.framesOffset, frameVertices, sizeof(Vertex)) ||
+        !inside(size, header.quantizedOffset, frameVertices, sizeof(TriangleVertex)) ||
+        !inside(size, header.normalsOffset, frameVertices, sizeof(GLuint)) ||
+        !inside(size, header.stsOffset, header.vertexCount, sizeof(VertexUV)) ||
+        !inside(size, header.indicesOffset, header.indexCount, sizeof(GLushort)) ||
+        !inside(size, header.lodIndicesOffset, lodIndexCount, sizeof(GLushort)))
+        return false;
+
+    const GLushort *indices = reinterpret_cast<const GLushort *>(data + header.indicesOffset);
+    for (unsigned int i = 0; i < header.indexCount; i++) {
+        if (indices[i] >= header.vertexCount && !((flags & BAKE_STRIPS) && indices[i] == PRIMITIVE_RESTART))
+            return false;
+    }
+    const GLushort *lodIndices = reinterpret_cast<const GLushort *>(data + header.lodIndicesOffset);
+    for (unsigned long long i = 0; i < lodIndexCount; i++) {
+        if (lodIndices[i] >= header.vertexCount)
+            return false;
+    }
+
+    this->base = data;
+    return true;
+}
@@ -0,0 +1,176 @@
+#include "md2_batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace {
+
+    bool hasMD2Extension(const std::string &name)
+    {
+        if (name.size() < 4)
+            return false;
+        std::string extension = name.substr(name.size() - 4);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".md2";
+    }
+
+    // Indices of the models the workers finished, picked up by the thread that owns the GL context
+    class LoadedQueue
+    {
+    public:
+        void push(size_t index)
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->loaded.push_back(index);
+            }
+            this->pushed.notify_one();
+        }
+
+        // waits for at least one index and takes all of them
+        void pop(std::vector<size_t> &indices)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->pushed.wait(lock, [this]() { return !this->loaded.empty(); });
+            indices.swap(this->loaded);
+            this->loaded.clear();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable pushed;
+        std::vector<size_t> loaded;
+    };
+
+    // Stops handing out paths and joins the workers however loadMD2Batch leaves, a joinable
+    // std::thread going out of scope calls std::terminate
+    class WorkerJoin
+    {
+    public:
+        WorkerJoin(std::vector<std::thread> &workers, std::atomic<size_t> &next, size_t end)
+            : workers(workers), next(next), end(end)
+        {
+        }
+
+        ~WorkerJoin()
+        {
+            this->next = this->end;
+            for (std::thread &worker : this->workers) {
+                if (worker.joinable())
+                    worker.join();
+            }
+        }
+
+    private:
+        std::vector<std::thread> &workers;
+        std::atomic<size_t> &next;
+        size_t end;
+    };
+}
+
+#ifdef _WIN32
+
+std::vector<std::string> listMD2Files(const char *directory)
+{
+    std::vector<std::string> paths;
+    std::string base(directory);
+    if (!base.empty() && base.back() != '/' && base.back() != '\\')
+        base += '/';
+
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((base + "*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE)
+        return paths;
+    do {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && hasMD2Extension(entry.cFileName))
+            paths.push_back(base + entry.cFileName);
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+#else
+
+std::vector<std::string> listMD2Files(const char *directory)
+{
+    std::vector<std::string> paths;
+    std::string base(directory);
+    if (!base.empty() && base.back() != '/')
+        base += '/';
+
+    DIR *dir = opendir(directory);
+    if (!dir)
+        return paths;
+    while (dirent *entry = readdir(dir)) {
+        if (hasMD2Extension(entry->d_name))
+            paths.push_back(base + entry->d_name);
+    }
+    closedir(dir);
+
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+#endif
+
+size_t loadMD2Batch(const std::vector<std::string> &paths, std::vector<MD2Model> &models,
+                    const std::function<void(size_t, MD2Model &)> &upload, unsigned int threads,
+                    bool glCommandStrips, bool useCache)
+{
+    std::vector<MD2Model>(paths.size()).swap(models);
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads, paths.size());
+
+    // every worker takes the next path until none are left, the files differ a lot in size so
+    // handing out one at a time balances better than splitting the list up front
+    std::atomic<size_t> next(0);
+    LoadedQueue loaded;
+    // what loadMD2 threw for a path, rethrown on the calling thread when its turn comes
+    std::vector<std::exception_ptr> errors(paths.size());
+    std::vector<std::thread> workers;
+    WorkerJoin join(workers, next, paths.size());
+    for (unsigned int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&]() {
+            for (size_t i = next++; i < paths.size(); i = next++) {
+                try {
+                    loadMD2(paths[i].c_str(), models[i], glCommandStrips, useCache);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+                loaded.push(i);
+            }
+        }));
+    }
+
+    // the calling thread does the uploads as the models come in
+    size_t count = 0;
+    std::vector<size_t> indices;
+    for (size_t finished = 0; finished < paths.size(); finished += indices.size()) {
+        loaded.pop(indices);
+        for (size_t i : indices) {
+            if (errors[i])
+                std::rethrow_exception(errors[i]);
+            if (!models[i].baked.valid())
+                continue;
+            count++;
+            if (upload)
+                upload(i, models[i]);
+        }
+    }
+
+    return count;
+}
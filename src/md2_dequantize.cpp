@@ -0,0 +1,202 @@
+#include "md2_dequantize.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MD2_DEQUANTIZE_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 is compiled into its own functions and only called when the cpu reports it, the rest of the
+// build stays at the baseline instruction set
+#if defined(MD2_DEQUANTIZE_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+#define MD2_DEQUANTIZE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+    // the reference the wider levels match, a multiply and an add rounded separately
+    void dequantizeScalar(const Frame &frame, const TriangleVertex *source, const unsigned short *indices,
+                          size_t count, Vertex *vertices)
+    {
+        for (size_t i = 0; i < count; i++) {
+            const TriangleVertex &v = source[indices ? indices[i] : i];
+            vertices[i].coords[0] = v.vertex[0] * frame.scale[0] + frame.translate[0];
+            vertices[i].coords[1] = v.vertex[2] * frame.scale[2] + frame.translate[2];
+            vertices[i].coords[2] = v.vertex[1] * frame.scale[1] + frame.translate[1];
+        }
+    }
+
+#ifdef MD2_DEQUANTIZE_SSE2
+
+    int loadVertex(const TriangleVertex *vertex)
+    {
+        int bits;
+        memcpy(&bits, vertex, sizeof(bits));
+        return bits;
+    }
+
+    // one vertex widened to x, y, z, normal index lanes, swapped to x, z, y and scaled, the last
+    // lane ends up zero and is never stored
+    inline __m128 dequantizeVertex(__m128i vertex, __m128 scale, __m128 translate)
+    {
+        __m128 swapped = _mm_cvtepi32_ps(_mm_shuffle_epi32(vertex, _MM_SHUFFLE(3, 1, 2, 0)));
+        return _mm_add_ps(_mm_mul_ps(swapped, scale), translate);
+    }
+
+    // four vertices at a time, the 16 bytes are widened to four x, z, y, 0 vectors and packed back
+    // into 12 tightly packed floats
+    size_t dequantizeSSE2(const Frame &frame, const TriangleVertex *source, const unsigned short *indices,
+                          size_t count, Vertex *vertices)
+    {
+        const __m128 scale = _mm_setr_ps(frame.scale[0], frame.scale[2], frame.scale[1], 0.0f);
+        const __m128 translate = _mm_setr_ps(frame.translate[0], frame.translate[2], frame.translate[1], 0.0f);
+        const __m128i zero = _mm_setzero_si128();
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i packed;
+            if (indices) {
+                packed = _mm_setr_epi32(loadVertex(source + indices[i]), loadVertex(source + indices[i + 1]),
+                                        loadVertex(source + indices[i + 2]), loadVertex(source + indices[i + 3]));
+            } else {
+                packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+            }
+            __m128i low = _mm_unpacklo_epi8(packed, zero);
+            __m128i high = _mm_unpackhi_epi8(packed, zero);
+            __m128 a = dequantizeVertex(_mm_unpacklo_epi16(low, zero), scale, translate);
+            __m128 b = dequantizeVertex(_mm_unpackhi_epi16(low, zero), scale, translate);
+            __m128 c = dequantizeVertex(_mm_unpacklo_epi16(high, zero), scale, translate);
+            __m128 d = dequantizeVertex(_mm_unpackhi_epi16(high, zero), scale, translate);
+
+            // a0 a1 a2 b0 | b1 b2 c0 c1 | c2 d0 d1 d2
+            __m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 2, 2));
+            __m128 cd = _mm_shuffle_ps(c, d, _MM_SHUFFLE(0, 0, 2, 2));
+            float *out = vertices[i].coords;
+            _mm_storeu_ps(out, _mm_shuffle_ps(a, ab, _MM_SHUFFLE(2, 0, 1, 0)));
+            _mm_storeu_ps(out + 4, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 2, 1)));
+            _mm_storeu_ps(out + 8, _mm_shuffle_ps(cd, d, _MM_SHUFFLE(2, 1, 2, 0)));
+        }
+        return i;
+    }
+
+#endif
+
+#ifdef MD2_DEQUANTIZE_AVX2
+
+    // two vertices in the low 8 bytes widened to x, z, y, 0 lanes each, scaled and packed into the
+    // low six lanes
+    AVX2_FUNCTION inline __m256 dequantizePair(__m128i pair, __m256 scale, __m256 translate)
+    {
+        __m256i vertex = _mm256_shuffle_epi32(_mm256_cvtepu8_epi32(pair), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256 position = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(vertex), scale), translate);
+        return _mm256_permutevar8x32_ps(position, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+    }
+
+    // eight vertices at a time, the indexed ones fetched with one gather. Every pair of vertices
+    // is six floats, the stores overlap by two lanes and the last one is masked so nothing past
+    // the eighth vertex is written.
+    AVX2_FUNCTION size_t dequantizeAVX2(const Frame &frame, const TriangleVertex *source,
+                                        const unsigned short *indices, size_t count, Vertex *vertices)
+    {
+        const __m256 scale = _mm256_setr_ps(frame.scale[0], frame.scale[2], frame.scale[1], 0.0f,
+                                            frame.scale[0], frame.scale[2], frame.scale[1], 0.0f);
+        const __m256 translate = _mm256_setr_ps(frame.translate[0], frame.translate[2], frame.translate[1], 0.0f,
+                                                frame.translate[0], frame.translate[2], frame.translate[1], 0.0f);
+        const __m256i sixLanes = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i packed;
+            if (indices) {
+                __m128i eight = _mm_loadu_si128(reinterpret_cast<const __m128i *>(indices + i));
+                __m256i offsets = _mm256_cvtepu16_epi32(eight);
+                packed = _mm256_i32gather_epi32(reinterpret_cast<const int *>(source), offsets, 4);
+            } else {
+                packed = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i));
+            }
+            __m128i low = _mm256_castsi256_si128(packed);
+            __m128i high = _mm256_extracti128_si256(packed, 1);
+            float *out = vertices[i].coords;
+            _mm256_storeu_ps(out, dequantizePair(low, scale, translate));
+            _mm256_storeu_ps(out + 6, dequantizePair(_mm_srli_si128(low, 8), scale, translate));
+            _mm256_storeu_ps(out + 12, dequantizePair(high, scale, translate));
+            _mm256_maskstore_ps(out + 18, sixLanes, dequantizePair(_mm_srli_si128(high, 8), scale, translate));
+        }
+        return i;
+    }
+
+    bool cpuHasAVX2()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        // the os has to save the ymm registers too
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+#endif
+}
+
+DequantizeLevel dequantizeSupport()
+{
+#if defined(MD2_DEQUANTIZE_AVX2)
+    static const DequantizeLevel level = cpuHasAVX2() ? DEQUANTIZE_AVX2 : DEQUANTIZE_SSE2;
+    return level;
+#elif defined(MD2_DEQUANTIZE_SSE2)
+    return DEQUANTIZE_SSE2;
+#else
+    return DEQUANTIZE_SCALAR;
+#endif
+}
+
+const char *dequantizeName(DequantizeLevel level)
+{
+    switch (level) {
+        case DEQUANTIZE_SSE2:
+            return "sse2";
+        case DEQUANTIZE_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+void dequantizeFrame(const Frame &frame, const TriangleVertex *source, const unsigned short *indices, size_t count,
+                     Vertex *vertices, DequantizeLevel level)
+{
+    if (level > dequantizeSupport())
+        level = dequantizeSupport();
+
+    // the wide loops leave the last few vertices to the scalar one
+    size_t done = 0;
+#ifdef MD2_DEQUANTIZE_AVX2
+    if (level == DEQUANTIZE_AVX2)
+        done = dequantizeAVX2(frame, source, indices, count, vertices);
+#endif
+#ifdef MD2_DEQUANTIZE_SSE2
+    if (level == DEQUANTIZE_SSE2)
+        done = dequantizeSSE2(frame, source, indices, count, vertices);
+#endif
+    if (indices)
+        dequantizeScalar(frame, source, indices + done, count - done, vertices + done);
+    else
+        dequantizeScalar(frame, source + done, NULL, count - done, vertices + done);
+}
@@ -0,0 +1,331 @@
+#include "md2_model.h"
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "md2_dequantize.h"
+#include "md2_normals.h"
+#include "mesh_optimizer.h"
+
+namespace {
+
+    void weldTriangles(MD2Model &model)
+    {
+        // the unique (vertex, uv) pairs of the triangle corners
+        std::map<std::pair<unsigned short, unsigned short>, GLushort> welds;
+        const MD2View &view = model.view;
+        for (int i = 0; i < view.triangleCount(); i++) {
+            const Mesh &mesh = *view.triangle(i);
+            for (size_t k = 0; k < 3; k++) {
+                std::pair<unsigned short, unsigned short> key(mesh.meshIndex[k], mesh.stIndex[k]);
+                auto weld = welds.find(key);
+                if (weld == welds.end()) {
+                    weld = welds.insert(std::make_pair(key, (GLushort) model.weldedVertices.size())).first;
+                    model.weldedVertices.push_back(mesh.meshIndex[k]);
+
+                    VertexUV uv;
+                    uv.st[0] = view.uv(mesh.stIndex[k])->s / (float) view.header().skinWidth;
+                    uv.st[1] = view.uv(mesh.stIndex[k])->t / (float) view.header().skinWidth;
+                    model.sts.push_back(uv);
+                }
+                model.indices.push_back(weld->second);
+            }
+        }
+
+        // reorder the triangles for the post-transform cache, then the vertices in first use order
+        MeshStats &stats = model.stats;
+        stats.acmrBefore = averageCacheMissRatio(model.indices, model.weldedVertices.size());
+        stats.atvrBefore = averageTransformedVertexRatio(model.indices, model.weldedVertices.size());
+        optimizeVertexCache(model.indices, model.weldedVertices.size());
+        std::vector<unsigned short> remap = optimizeVertexFetch(model.indices, model.weldedVertices.size());
+        std::vector<unsigned short> fetchVertices(model.weldedVertices.size());
+        std::vector<VertexUV> fetchSts(model.sts.size());
+        for (size_t i = 0; i < remap.size(); i++) {
+            fetchVertices[remap[i]] = model.weldedVertices[i];
+            fetchSts[remap[i]] = model.sts[i];
+        }
+        model.weldedVertices.swap(fetchVertices);
+        model.sts.swap(fetchSts);
+        stats.acmrAfter = averageCacheMissRatio(model.indices, model.weldedVertices.size());
+        stats.atvrAfter = averageTransformedVertexRatio(model.indices, model.weldedVertices.size());
+        stats.listIndices = model.indices.size();
+        stats.listVertices = model.weldedVertices.size();
+    }
+
+    // the gl commands are the same mesh as strips and fans, with their own texture coordinates
+    void buildStrips(MD2Model &model, std::vector<unsigned short> &stripVertices,
+                     std::vector<VertexUV> &stripSts, std::vector<GLushort> &stripIndices)
+    {
+        const MD2View &view = model.view;
+        const int *glCommands = view.glCommands();
+        size_t glCommandCount = view.glCommandCount();
+        std::map<std::tuple<int, float, float>, GLushort> stripWelds;
+        size_t strips = 0;
+        size_t i = 0;
+        while (i < glCommandCount && glCommands[i] != 0) {
+            // positive counts are strips, negative ones fans. The magnitude is taken in 64 bits so
+            // INT_MIN has one, and checked against what is left before it is multiplied.
+            size_t count = static_cast<size_t>(std::abs(static_cast<long long>(glCommands[i])));
+            bool fan = glCommands[i] < 0;
+            i++;
+            if (count > (glCommandCount - i) / 3)
+                break;
+
+            const GlCommandVertex *commandVertices = reinterpret_cast<const GlCommandVertex *>(&glCommands[i]);
+            i += count * 3;
+            bool broken = false;
+            for (size_t k = 0; k < count; k++)
+                broken |= commandVertices[k].vertexIndex < 0 || commandVertices[k].vertexIndex >= view.vertexCount();
+            if (broken)
+                continue;
+
+            std::vector<unsigned short> primitive;
+            for (size_t k = 0; k < count; k++) {
+                const GlCommandVertex &v = commandVertices[k];
+                std::tuple<int, float, float> key(v.vertexIndex, v.s, v.t);
+                auto weld = stripWelds.find(key);
+                if (weld == stripWelds.end()) {
+                    weld = stripWelds.insert(std::make_pair(key, (GLushort) stripVertices.size())).first;
+                    stripVertices.push_back(v.vertexIndex);
+
+                    // gl command coordinates are normalized by the skin size, bring t to the
+                    // skinWidth scale the triangle list uses
+                    VertexUV uv;
+                    uv.st[0] = v.s;
+                    uv.st[1] = v.t * view.header().skinHeight / (float) view.header().skinWidth;
+                    stripSts.push_back(uv);
+                }
+                primitive.push_back(weld->second);
+            }
+
+            if (!stripIndices.empty())
+                stripIndices.push_back(PRIMITIVE_RESTART);
+            if (fan)
+                appendFanAsStrip(stripIndices, primitive);
+            else
+                stripIndices.insert(stripIndices.end(), primitive.begin(), primitive.end());
+            strips++;
+        }
+
+        MeshStats &stats = model.stats;
+        stats.stripIndices = stripIndices.size();
+        stats.stripVertices = stripVertices.size();
+        stats.strips = strips;
+        stats.stripAcmr = averageCacheMissRatio(unpackStrips(stripIndices), stripVertices.size());
+    }
+}
+
+bool readFile(const char *path, std::vector<char> &data)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(file);
+        return false;
+    }
+
+    data.resize(size);
+    size_t read = size > 0 ? fread(data.data(), 1, size, file) : 0;
+    fclose(file);
+    return read == static_cast<size_t>(size);
+}
+
+bool writeFile(const char *path, const std::vector<char> &data)
+{
+    std::string temporary = std::string(path) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    written = fclose(file) == 0 && written;
+    // rename doesn't replace an existing file on windows
+    if (written && std::rename(temporary.c_str(), path) != 0) {
+        std::remove(path);
+        written = std::rename(temporary.c_str(), path) == 0;
+    }
+    if (!written)
+        std::remove(temporary.c_str());
+    return written;
+}
+
+bool parseMD2(const char *data, size_t size, MD2Model &model)
+{
+    return model.view.open(data, size);
+}
+
+void buildMesh(MD2Model &model, bool glCommandStrips)
+{
+    model.weldedVertices.clear();
+    model.sts.clear();
+    model.indices.clear();
+    weldTriangles(model);
+
+    std::vector<unsigned short> stripVertices;
+    std::vector<VertexUV> stripSts;
+    std::vector<GLushort> stripIndices;
+    buildStrips(model, stripVertices, stripSts, stripIndices);
+
+    model.strips = glCommandStrips;
+    if (glCommandStrips) {
+        model.weldedVertices.swap(stripVertices);
+        model.sts.swap(stripSts);
+        model.indices.swap(stripIndices);
+    }
+}
+
+void decodeFrames(MD2Model &model)
+{
+    const std::vector<unsigned short> &welded = model.weldedVertices;
+    const MD2View &view = model.view;
+    model.frameVertices.resize(view.frameCount() * welded.size());
+    model.quantizedFrames.resize(view.frameCount() * welded.size());
+    model.frameNormals.resize(view.frameCount() * welded.size());
+    FrameView<Vertex> frames(model.frameVertices.data(), view.frameCount(), welded.size());
+    FrameView<TriangleVertex> quantizedFrames(model.quantizedFrames.data(), view.frameCount(), welded.size());
+    FrameView<GLuint> frameNormals(model.frameNormals.data(), view.frameCount(), welded.size());
+
+    // every byte value packed once, broken files with indices past the table get zero normals
+    GLuint normals[256];
+    for (int i = 0; i < 256; i++)
+        normals[i] = md2Normal(i);
+
+    for (int p = 0; p < view.frameCount(); p++) {
+        const Frame &frame = *view.frame(p);
+        const TriangleVertex *source = view.frameVertices(p);
+        Vertex *frameVertex = frames[p];
+        TriangleVertex *quantizedFrame = quantizedFrames[p];
+        GLuint *frameNormal = frameNormals[p];
+
+        // md2 is z up, y and z are swapped while dequantizing
+        dequantizeFrame(frame, source, welded.data(), welded.size(), frameVertex);
+        for (size_t i = 0; i < welded.size(); i++) {
+            const TriangleVertex &v = source[welded[i]];
+            quantizedFrame[i] = v;
+            frameNormal[i] = normals[v.lightNormalIndex];
+        }
+    }
+}
+
+void simplifyMesh(MD2Model &model)
+{
+    // strips are simplified as the triangles they draw, the levels are triangle lists either way
+    const std::vector<GLushort> &indices = model.strips ? unpackStrips(model.indices) : model.indices;
+    FrameView<const Vertex> frames(model.frameVertices.data(), model.view.frameCount(), model.weldedVertices.size());
+    std::vector<size_t> targets;
+    for (int level = 1; level <= LOD_LEVELS; level++)
+        targets.push_back((indices.size() / 3) >> level);
+    std::vector<std::vector<GLushort>> levels = simplifyAnimatedMesh(indices, model.weldedVertices, frames, targets);
+    for (int level = 0; level < LOD_LEVELS; level++)
+        model.lodIndices[level].swap(levels[level]);
+}
+
+void bakeMD2(const MD2Model &model, unsigned long long sourceChecksum, std::vector<char> &baked)
+{
+    size_t vertexCount = model.weldedVertices.size();
+    size_t frameCount = vertexCount ? model.frameVertices.size() / vertexCount : 0;
+
+    BakeHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "BWMD", 4);
+    header.version = BAKE_VERSION;
+    header.headerSize = sizeof(BakeHeader);
+    header.flags = model.strips ? BAKE_STRIPS : 0;
+    header.sourceSize = model.view.size();
+    header.sourceChecksum = sourceChecksum;
+    header.frameCount = frameCount;
+    header.vertexCount = vertexCount;
+    header.indexCount = model.indices.size();
+    header.stats = model.stats;
+    size_t lodIndexCount = 0;
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        header.lodIndexCounts[level] = model.lodIndices[level].size();
+        lodIndexCount += model.lodIndices[level].size();
+    }
+
+    // each stream starts on the next aligned offset
+    unsigned long long offset = sizeof(BakeHeader);
+    unsigned long long *offsets[] = {&header.framesOffset, &header.quantizedOffset, &header.normalsOffset,
+                                     &header.stsOffset, &header.indicesOffset, &header.lodIndicesOffset,
+                                     &header.fileSize};
+    size_t sizes[] = {frameCount * vertexCount * sizeof(Vertex), frameCount * vertexCount * sizeof(TriangleVertex),
+                      frameCount * vertexCount * sizeof(GLuint), vertexCount * sizeof(VertexUV),
+                      model.indices.size() * sizeof(GLushort), lodIndexCount * sizeof(GLushort), 0};
+    for (size_t i = 0; i < 7; i++) {
+        offset = (offset + BAKE_ALIGNMENT - 1) / BAKE_ALIGNMENT * BAKE_ALIGNMENT;
+        *offsets[i] = offset;
+        offset += sizes[i];
+    }
+
+    baked.assign(header.fileSize, 0);
+    memcpy(baked.data(), &header, sizeof(header));
+    memcpy(&baked[header.framesOffset], model.frameVertices.data(), sizes[0]);
+    memcpy(&baked[header.quantizedOffset], model.quantizedFrames.data(), sizes[1]);
+    memcpy(&baked[header.normalsOffset], model.frameNormals.data(), sizes[2]);
+    memcpy(&baked[header.stsOffset], model.sts.data(), sizes[3]);
+    memcpy(&baked[header.indicesOffset], model.indices.data(), sizes[4]);
+    size_t lodOffset = header.lodIndicesOffset;
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        memcpy(&baked[lodOffset], model.lodIndices[level].data(), model.lodIndices[level].size() * sizeof(GLushort));
+        lodOffset += model.lodIndices[level].size() * sizeof(GLushort);
+    }
+}
+
+bool loadMD2(const char *path, MD2Model &model, bool glCommandStrips, bool useCache)
+{
+    if (!model.file.open(path)) {
+        std::cerr << "load model failure" << std::endl;
+        return false;
+    }
+    if (!parseMD2(model.file.data(), model.file.size(), model))
+        return false;
+
+    unsigned long long sourceChecksum = checksum(model.file.data(), model.file.size());
+    unsigned int flags = glCommandStrips ? BAKE_STRIPS : 0;
+    std::string bakePath = std::string(path) + ".bake";
+    if (useCache && model.bakedFile.open(bakePath.c_str()) &&
+        model.baked.open(model.bakedFile.data(), model.bakedFile.size(), model.file.size(), sourceChecksum, flags) &&
+        model.baked.frameCount() == model.view.frameCount()) {
+        model.strips = glCommandStrips;
+        model.stats = model.baked.header().stats;
+        return true;
+    }
+    model.bakedFile.close();
+
+    buildMesh(model, glCommandStrips);
+    decodeFrames(model);
+    simplifyMesh(model);
+    bakeMD2(model, sourceChecksum, model.bakedData);
+
+    // the baked streams are all that's drawn from now on
+    std::vector<unsigned short>().swap(model.weldedVertices);
+    std::vector<VertexUV>().swap(model.sts);
+    std::vector<GLushort>().swap(model.indices);
+    std::vector<Vertex>().swap(model.frameVertices);
+    std::vector<TriangleVertex>().swap(model.quantizedFrames);
+    std::vector<GLuint>().swap(model.frameNormals);
+    for (int level = 0; level < LOD_LEVELS; level++)
+        std::vector<GLushort>().swap(model.lodIndices[level]);
+
+    if (useCache && writeFile(bakePath.c_str(), model.bakedData) && model.bakedFile.open(bakePath.c_str()) &&
+        model.baked.open(model.bakedFile.data(), model.bakedFile.size(), model.file.size(), sourceChecksum, flags)) {
+        std::vector<char>().swap(model.bakedData);
+        return true;
+    }
+    model.bakedFile.close();
+    if (useCache)
+        std::cerr << "can't write " << bakePath << ", keeping the baked model in memory" << std::endl;
+    return model.baked.open(model.bakedData.data(), model.bakedData.size(), model.file.size(), sourceChecksum,
+                            flags);
+}
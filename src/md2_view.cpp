@@ -0,0 +1,59 @@
+#include "md2_view.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+    // true when count records of size bytes starting at offset lie inside the data, 4 byte aligned
+    // so the views can be read in place
+    bool inside(size_t size, int offset, int count, size_t recordSize)
+    {
+        return offset >= 0 && count >= 0 && offset % 4 == 0 && static_cast<size_t>(offset) <= size &&
+               static_cast<size_t>(count) * recordSize <= size - offset;
+    }
+}
+
+bool MD2View::open(const char *data, size_t size)
+{
+    this->base = NULL;
+    this->length = 0;
+
+    if (size < sizeof(MD2) || reinterpret_cast<size_t>(data) % 4 != 0) {
+        std::cerr << "not MD2 model" << std::endl;
+        return false;
+    }
+    const MD2 &md2 = *reinterpret_cast<const MD2 *>(data);
+    std::string magic(reinterpret_cast<const char *>(&md2.magic), 4);
+    if (magic != "IDP2") {
+        std::cerr << "not MD2 model" << std::endl;
+        return false;
+    }
+
+    // a frame is its header followed by numVertices packed vertices
+    size_t frameHeaderSize = offsetof(Frame, vertices);
+    if (md2.numVertices < 1 || md2.frameSize < 0 || md2.frameSize % 4 != 0 ||
+        static_cast<size_t>(md2.frameSize) < frameHeaderSize + md2.numVertices * sizeof(TriangleVertex) ||
+        !inside(size, md2.offsetFrames, md2.numFrames, md2.frameSize) ||
+        !inside(size, md2.offsetTexCoords, md2.numTexCoords, sizeof(MeshUV)) ||
+        !inside(size, md2.offsetTriangles, md2.numTriangles, sizeof(Mesh)) ||
+        !inside(size, md2.offsetGlCommands, md2.numGlCommands, sizeof(int))) {
+        std::cerr << "broken MD2 model" << std::endl;
+        return false;
+    }
+
+    const Mesh *triangles = reinterpret_cast<const Mesh *>(data + md2.offsetTriangles);
+    for (int i = 0; i < md2.numTriangles; i++) {
+        for (size_t k = 0; k < 3; k++) {
+            if (triangles[i].meshIndex[k] >= md2.numVertices || triangles[i].stIndex[k] >= md2.numTexCoords) {
+                std::cerr << "broken MD2 model" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    this->base = data;
+    this->length = size;
+    return true;
+}
@@ -0,0 +1,233 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    // the scoring cache is an lru of this size, larger than the hardware cache as in the paper
+    const int SCORE_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    float vertexScore(int cachePosition, int remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // the vertices of the triangle just emitted get a fixed score so the next triangle
+                // does not simply continue a strip
+                score = LAST_TRIANGLE_SCORE;
+            } else {
+                float scaler = 1.0f / (SCORE_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+        // prefer finishing vertices with few triangles left so they leave the cache for good
+        score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    size_t countCacheMisses(const std::vector<unsigned short> &indices, size_t vertexCount, size_t cacheSize)
+    {
+        // fifo cache, timestamps tell if a vertex is still inside
+        std::vector<size_t> cachedAt(vertexCount, 0);
+        size_t time = cacheSize + 1;
+        size_t misses = 0;
+        for (size_t i = 0; i < indices.size(); i++) {
+            unsigned short v = indices[i];
+            if (time - cachedAt[v] > cacheSize) {
+                cachedAt[v] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+}
+
+void optimizeVertexCache(std::vector<unsigned short> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles of each vertex, packed in one array
+    std::vector<int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+        remaining[indices[i]]++;
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<size_t> adjacency(indices.size());
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned short> result;
+    result.reserve(indices.size());
+
+    std::vector<unsigned short> cache, nextCache;
+    size_t scan = 0;
+    long best = -1;
+
+    while (result.size() < indices.size()) {
+        if (best < 0) {
+            // nothing useful in the cache, take the best triangle left
+            float bestScore = -1.0f;
+            for (size_t t = scan; t < triangleCount; t++) {
+                if (!emitted[t] && triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+            while (scan < triangleCount && emitted[scan])
+                scan++;
+        }
+
+        emitted[best] = true;
+        const unsigned short *triangle = &indices[best * 3];
+
+        // emitted vertices go to the front of the cache, the rest keeps its order
+        nextCache.clear();
+        for (int k = 0; k < 3; k++) {
+            unsigned short v = triangle[k];
+            result.push_back(v);
+            nextCache.push_back(v);
+
+            // drop the triangle from the vertex's list of remaining ones
+            size_t *begin = &adjacency[offsets[v]];
+            size_t *end = begin + remaining[v];
+            *std::find(begin, end, static_cast<size_t>(best)) = *(end - 1);
+            remaining[v]--;
+        }
+        for (size_t i = 0; i < cache.size(); i++) {
+            unsigned short v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        }
+        for (size_t i = SCORE_CACHE_SIZE; i < nextCache.size(); i++)
+            cachePosition[nextCache[i]] = -1;
+        if (nextCache.size() > static_cast<size_t>(SCORE_CACHE_SIZE))
+            nextCache.resize(SCORE_CACHE_SIZE);
+        cache.swap(nextCache);
+
+        // rescore the cached vertices and pick the next triangle among their triangles
+        for (size_t i = 0; i < cache.size(); i++) {
+            cachePosition[cache[i]] = i;
+            score[cache[i]] = vertexScore(i, remaining[cache[i]]);
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < cache.size(); i++) {
+            unsigned short v = cache[i];
+            for (int j = 0; j < remaining[v]; j++) {
+                size_t t = adjacency[offsets[v] + j];
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+std::vector<unsigned short> optimizeVertexFetch(std::vector<unsigned short> &indices, size_t vertexCount)
+{
+    const unsigned short unused = 0xffff;
+    std::vector<unsigned short> remap(vertexCount, unused);
+    unsigned short next = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        unsigned short &v = indices[i];
+        if (remap[v] == unused)
+            remap[v] = next++;
+        v = remap[v];
+    }
+    // vertices no triangle uses go to the end
+    for (size_t v = 0; v < vertexCount; v++)
+        if (remap[v] == unused)
+            remap[v] = next++;
+    return remap;
+}
+
+void appendFanAsStrip(std::vector<unsigned short> &strip, const std::vector<unsigned short> &fan)
+{
+    if (fan.size() < 3)
+        return;
+
+    // (v1, v2, c, v3) covers the first two triangles, after that the strip alternates between
+    // continuing around the center and restarting at it with a degenerate pair
+    unsigned short center = fan[0];
+    strip.push_back(fan[1]);
+    strip.push_back(fan[2]);
+    strip.push_back(center);
+    if (fan.size() > 3)
+        strip.push_back(fan[3]);
+    for (size_t k = 4; k < fan.size(); k++) {
+        if (k % 2 == 0) {
+            strip.push_back(fan[k]);
+        } else {
+            strip.push_back(fan[k - 1]);
+            strip.push_back(center);
+            strip.push_back(fan[k]);
+        }
+    }
+}
+
+std::vector<unsigned short> unpackStrips(const std::vector<unsigned short> &strips)
+{
+    std::vector<unsigned short> triangles;
+    size_t start = 0;
+    for (size_t i = 0; i < strips.size(); i++) {
+        if (strips[i] == PRIMITIVE_RESTART) {
+            start = i + 1;
+            continue;
+        }
+        if (i - start < 2)
+            continue;
+
+        // odd triangles of a strip swap their first two vertices to keep the winding
+        unsigned short a = strips[i - 2], b = strips[i - 1], c = strips[i];
+        if ((i - start) % 2 == 1)
+            std::swap(a, b);
+        if (a == b || b == c || a == c)
+            continue;
+        triangles.push_back(a);
+        triangles.push_back(b);
+        triangles.push_back(c);
+    }
+    return triangles;
+}
+
+float averageCacheMissRatio(const std::vector<unsigned short> &indices, size_t vertexCount, size_t cacheSize)
+{
+    if (indices.empty())
+        return 0.0f;
+    return static_cast<float>(countCacheMisses(indices, vertexCount, cacheSize)) / (indices.size() / 3);
+}
+
+float averageTransformedVertexRatio(const std::vector<unsigned short> &indices, size_t vertexCount,
+                                    size_t cacheSize)
+{
+    if (vertexCount == 0)
+        return 0.0f;
+    return static_cast<float>(countCacheMisses(indices, vertexCount, cacheSize)) / vertexCount;
+}
@@ -0,0 +1,431 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <queue>
+
+#include "mesh_optimizer.h"
+
+namespace {
+
+    // Symmetric 4x4 matrix of a sum of squared plane distances, a b c d of every plane
+    struct Quadric {
+        double aa, ab, ac, ad, bb, bc, bd, cc, cd, dd;
+
+        void add(const Quadric &other)
+        {
+            aa += other.aa; ab += other.ab; ac += other.ac; ad += other.ad; bb += other.bb;
+            bc += other.bc; bd += other.bd; cc += other.cc; cd += other.cd; dd += other.dd;
+        }
+
+        // plane through the triangle weighted by its area, so slivers count little
+        void addTriangle(const Vertex &p0, const Vertex &p1, const Vertex &p2)
+        {
+            double e1[3], e2[3], n[3];
+            for (int k = 0; k < 3; k++) {
+                e1[k] = p1.coords[k] - p0.coords[k];
+                e2[k] = p2.coords[k] - p0.coords[k];
+            }
+            n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length == 0.0)
+                return;
+            double area = 0.5 * length;
+            double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+            double d = -(a * p0.coords[0] + b * p0.coords[1] + c * p0.coords[2]);
+            aa += area * a * a; ab += area * a * b; ac += area * a * c; ad += area * a * d;
+            bb += area * b * b; bc += area * b * c; bd += area * b * d;
+            cc += area * c * c; cd += area * c * d; dd += area * d * d;
+        }
+
+        double error(const Vertex &v) const
+        {
+            double x = v.coords[0], y = v.coords[1], z = v.coords[2];
+            return aa * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x + bb * y * y +
+                   2.0 * bc * y * z + 2.0 * bd * y + cc * z * z + 2.0 * cd * z + dd;
+        }
+    };
+
+    // weight of the planes that hold open edges and uv seams in place, relative to the surface
+    const double BORDER_WEIGHT = 10.0;
+
+    void cross(const double *a, const double *b, double *n)
+    {
+        n[0] = a[1] * b[2] - a[2] * b[1];
+        n[1] = a[2] * b[0] - a[0] * b[2];
+        n[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    double dot(const double *a, const double *b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    void edge(const Vertex &from, const Vertex &to, double *e)
+    {
+        for (int k = 0; k < 3; k++)
+            e[k] = to.coords[k] - from.coords[k];
+    }
+
+    // Collapse of every copy of position from onto a copy of position to
+    struct Collapse {
+        double cost;
+        unsigned short from;
+        unsigned short to;
+        unsigned int version;
+
+        bool operator<(const Collapse &other) const { return this->cost > other.cost; }
+    };
+
+    typedef std::vector<std::pair<unsigned short, unsigned short>> Pairs;
+
+    // Works on positions, the copies of a position that a uv seam splits into several mesh vertices
+    // always move together so the seam never opens up
+    class Simplifier
+    {
+    public:
+        Simplifier(const std::vector<unsigned short> &indices, const std::vector<unsigned short> &positions,
+                   const FrameView<const Vertex> &frames)
+            : frames(frames), positions(positions), triangles(indices), alive(indices.size() / 3, true),
+              liveTriangles(indices.size() / 3)
+        {
+            size_t vertexCount = frames.vertexCount();
+            size_t sampleCount = std::min<size_t>(frames.frameCount(), SIMPLIFY_SAMPLE_FRAMES);
+            for (size_t s = 0; s < sampleCount; s++)
+                this->samples.push_back(s * frames.frameCount() / sampleCount);
+
+            this->vertexTriangles.resize(vertexCount);
+            for (size_t t = 0; t < this->liveTriangles; t++) {
+                for (size_t k = 0; k < 3; k++)
+                    this->vertexTriangles[this->triangles[t * 3 + k]].push_back(t);
+            }
+            size_t positionCount = 0;
+            for (unsigned short position : positions)
+                positionCount = std::max<size_t>(positionCount, position + 1);
+            this->copies.resize(positionCount);
+            for (size_t v = 0; v < vertexCount; v++)
+                this->copies[positions[v]].push_back(v);
+
+            Quadric zero = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+            this->quadrics.assign(vertexCount * sampleCount, zero);
+            for (size_t t = 0; t < this->liveTriangles; t++) {
+                const unsigned short *v = &this->triangles[t * 3];
+                for (size_t s = 0; s < sampleCount; s++) {
+                    const Vertex *frame = frames[this->samples[s]];
+                    Quadric plane = zero;
+                    plane.addTriangle(frame[v[0]], frame[v[1]], frame[v[2]]);
+                    for (size_t k = 0; k < 3; k++)
+                        this->quadrics[v[k] * sampleCount + s].add(plane);
+                }
+            }
+
+            // edges of a single triangle are open edges or uv seams, their vertices may only slide
+            // along them and get a plane through the edge upright on the triangle to stay close to
+            // it. Edges of more than two triangles and vertices where borders meet don't move at all.
+            std::vector<uint64_t> edges;
+            for (size_t t = 0; t < this->liveTriangles; t++) {
+                for (size_t k = 0; k < 3; k++) {
+                    uint64_t a = this->triangles[t * 3 + k], b = this->triangles[t * 3 + (k + 1) % 3];
+                    edges.push_back((std::min(a, b) << 16 | std::max(a, b)) << 32 | t);
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            std::vector<int> borderEdges(vertexCount, 0);
+            std::vector<bool> locked(vertexCount, false);
+            for (size_t i = 0; i < edges.size();) {
+                size_t j = i;
+                while (j < edges.size() && edges[j] >> 32 == edges[i] >> 32)
+                    j++;
+                unsigned short a = edges[i] >> 48, b = (edges[i] >> 32) & 0xffff;
+                if (j - i == 1) {
+                    borderEdges[a]++;
+                    borderEdges[b]++;
+                    this->addBorderPlane(a, b, edges[i] & 0xffffffff);
+                } else if (j - i > 2) {
+                    locked[a] = true;
+                    locked[b] = true;
+                }
+                i = j;
+            }
+            this->border.assign(vertexCount, false);
+            this->lockedPositions.assign(positionCount, false);
+            for (size_t v = 0; v < vertexCount; v++) {
+                this->border[v] = borderEdges[v] > 0;
+                if (locked[v] || (borderEdges[v] != 0 && borderEdges[v] != 2))
+                    this->lockedPositions[positions[v]] = true;
+            }
+
+            this->versions.assign(positionCount, 0);
+            for (size_t p = 0; p < positionCount; p++)
+                this->queueBest(p);
+        }
+
+        size_t triangleCount() const { return this->liveTriangles; }
+
+        // does the cheapest collapse left, false when none is possible
+        bool collapseNext()
+        {
+            while (!this->queue.empty()) {
+                Collapse collapse = this->queue.top();
+                this->queue.pop();
+                Pairs pairs;
+                if (collapse.version != this->versions[collapse.from] ||
+                    !this->pair(collapse.from, collapse.to, pairs))
+                    continue;
+                this->collapse(collapse.from, collapse.to, pairs);
+                return true;
+            }
+            return false;
+        }
+
+        std::vector<unsigned short> triangleList() const
+        {
+            std::vector<unsigned short> indices;
+            for (size_t t = 0; t < this->alive.size(); t++) {
+                if (this->alive[t])
+                    indices.insert(indices.end(), &this->triangles[t * 3], &this->triangles[t * 3 + 3]);
+            }
+            optimizeVertexCache(indices, this->frames.vertexCount());
+            return indices;
+        }
+
+    private:
+        void addBorderPlane(unsigned short a, unsigned short b, size_t triangle)
+        {
+            const unsigned short *v = &this->triangles[triangle * 3];
+            unsigned short c = v[0] != a && v[0] != b ? v[0] : v[1] != a && v[1] != b ? v[1] : v[2];
+            for (size_t s = 0; s < this->samples.size(); s++) {
+                const Vertex *frame = this->frames[this->samples[s]];
+                double e[3], f[3], n[3], m[3];
+                edge(frame[a], frame[b], e);
+                edge(frame[a], frame[c], f);
+                cross(e, f, n);
+                cross(e, n, m);
+                double length = std::sqrt(dot(m, m));
+                if (length == 0.0)
+                    continue;
+                for (int k = 0; k < 3; k++)
+                    m[k] /= length;
+                double d = -(m[0] * frame[a].coords[0] + m[1] * frame[a].coords[1] + m[2] * frame[a].coords[2]);
+                double weight = BORDER_WEIGHT * dot(e, e);
+                Quadric plane = {weight * m[0] * m[0], weight * m[0] * m[1], weight * m[0] * m[2], weight * m[0] * d,
+                                 weight * m[1] * m[1], weight * m[1] * m[2], weight * m[1] * d,
+                                 weight * m[2] * m[2], weight * m[2] * d, weight * d * d};
+                this->quadrics[a * this->samples.size() + s].add(plane);
+                this->quadrics[b * this->samples.size() + s].add(plane);
+            }
+        }
+
+        std::vector<unsigned short> neighbours(size_t v) const
+        {
+            std::vector<unsigned short> result;
+            for (size_t t : this->vertexTriangles[v]) {
+                if (!this->alive[t])
+                    continue;
+                for (size_t k = 0; k < 3; k++) {
+                    if (this->triangles[t * 3 + k] != v)
+                        result.push_back(this->triangles[t * 3 + k]);
+                }
+            }
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+            return result;
+        }
+
+        double cost(size_t from, size_t to) const
+        {
+            double error = 0.0;
+            for (size_t s = 0; s < this->samples.size(); s++)
+                error += this->quadrics[from * this->samples.size() + s].error(this->frames[this->samples[s]][to]);
+            return error;
+        }
+
+        // Every copy of position from needs exactly one neighbour among the copies of to, each a
+        // different one, and every one of those edges has to collapse on its own
+        bool pair(size_t from, size_t to, Pairs &pairs) const
+        {
+            if (this->copies[from].empty() || this->copies[to].empty())
+                return false;
+            for (unsigned short a : this->copies[from]) {
+                std::vector<unsigned short> candidates = this->neighbours(a);
+                unsigned short b = 0;
+                int found = 0;
+                for (unsigned short n : candidates) {
+                    if (this->positions[n] == to) {
+                        b = n;
+                        found++;
+                    }
+                }
+                if (found != 1)
+                    return false;
+                for (const std::pair<unsigned short, unsigned short> &other : pairs) {
+                    if (other.second == b)
+                        return false;
+                }
+                if (!this->canCollapse(a, b))
+                    return false;
+                pairs.push_back(std::make_pair(a, b));
+            }
+            return true;
+        }
+
+        // An interior edge may only have the two triangles on it as common neighbours and an edge
+        // on a border only its one triangle, or the collapse would pinch the surface. A border
+        // vertex only slides along its border and no triangle that stays may flip over in any
+        // sampled frame.
+        bool canCollapse(size_t from, size_t to) const
+        {
+            std::vector<unsigned short> fromNeighbours = this->neighbours(from);
+            std::vector<unsigned short> toNeighbours = this->neighbours(to);
+            std::vector<unsigned short> common;
+            std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(),
+                                  toNeighbours.end(), std::back_inserter(common));
+            size_t shared = 0;
+            for (size_t t : this->vertexTriangles[from]) {
+                if (!this->alive[t])
+                    continue;
+                const unsigned short *v = &this->triangles[t * 3];
+                if (v[0] == to || v[1] == to || v[2] == to) {
+                    shared++;
+                    continue;
+                }
+                for (size_t frame : this->samples) {
+                    const Vertex *positions = this->frames[frame];
+                    double before[3], after[3];
+                    this->normal(positions, v, from, from, before);
+                    this->normal(positions, v, from, to, after);
+                    if (dot(before, after) <= 0.0)
+                        return false;
+                }
+            }
+            size_t expected = this->border[from] ? 1 : 2;
+            return shared == expected && common.size() == expected;
+        }
+
+        // unnormalized normal of triangle v with vertex from moved onto to
+        void normal(const Vertex *positions, const unsigned short *v, size_t from, size_t to, double *n) const
+        {
+            const Vertex *p[3];
+            for (size_t k = 0; k < 3; k++)
+                p[k] = &positions[v[k] == from ? to : v[k]];
+            double e1[3], e2[3];
+            edge(*p[0], *p[1], e1);
+            edge(*p[0], *p[2], e2);
+            cross(e1, e2, n);
+        }
+
+        // queues the cheapest collapse of position p that is allowed right now, older entries of p
+        // go stale
+        void queueBest(size_t p)
+        {
+            this->versions[p]++;
+            if (this->lockedPositions[p] || this->copies[p].empty())
+                return;
+            std::vector<unsigned short> targets;
+            for (unsigned short v : this->copies[p]) {
+                for (unsigned short n : this->neighbours(v))
+                    targets.push_back(this->positions[n]);
+            }
+            std::sort(targets.begin(), targets.end());
+            targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+            Collapse best = {0.0, static_cast<unsigned short>(p), 0, this->versions[p]};
+            bool found = false;
+            for (unsigned short target : targets) {
+                Pairs pairs;
+                if (!this->pair(p, target, pairs))
+                    continue;
+                double cost = 0.0;
+                for (const std::pair<unsigned short, unsigned short> &edge : pairs)
+                    cost += this->cost(edge.first, edge.second);
+                if (!found || cost < best.cost) {
+                    best.cost = cost;
+                    best.to = target;
+                    found = true;
+                }
+            }
+            if (found)
+                this->queue.push(best);
+        }
+
+        void collapse(size_t from, size_t to, const Pairs &pairs)
+        {
+            for (const std::pair<unsigned short, unsigned short> &edge : pairs)
+                this->collapseVertex(edge.first, edge.second);
+            this->copies[from].clear();
+            this->versions[from]++;
+
+            std::vector<unsigned short> affected(1, to);
+            for (unsigned short v : this->copies[to]) {
+                for (unsigned short n : this->neighbours(v))
+                    affected.push_back(this->positions[n]);
+            }
+            std::sort(affected.begin(), affected.end());
+            affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+            for (unsigned short p : affected)
+                this->queueBest(p);
+        }
+
+        void collapseVertex(unsigned short from, unsigned short to)
+        {
+            for (size_t t : this->vertexTriangles[from]) {
+                if (!this->alive[t])
+                    continue;
+                unsigned short *v = &this->triangles[t * 3];
+                if (v[0] == to || v[1] == to || v[2] == to) {
+                    this->alive[t] = false;
+                    this->liveTriangles--;
+                    continue;
+                }
+                for (size_t k = 0; k < 3; k++) {
+                    if (v[k] == from)
+                        v[k] = to;
+                }
+                this->vertexTriangles[to].push_back(t);
+            }
+            std::vector<size_t>().swap(this->vertexTriangles[from]);
+            for (size_t s = 0; s < this->samples.size(); s++)
+                this->quadrics[to * this->samples.size() + s].add(this->quadrics[from * this->samples.size() + s]);
+        }
+
+        const FrameView<const Vertex> &frames;
+        const std::vector<unsigned short> &positions;
+        std::vector<size_t> samples;
+        std::vector<unsigned short> triangles;
+        std::vector<bool> alive;
+        size_t liveTriangles;
+        std::vector<std::vector<size_t>> vertexTriangles;
+        // the live mesh vertices of every position
+        std::vector<std::vector<unsigned short>> copies;
+        // samples.size() quadrics per vertex
+        std::vector<Quadric> quadrics;
+        std::vector<bool> border;
+        std::vector<bool> lockedPositions;
+        std::vector<unsigned int> versions;
+        std::priority_queue<Collapse> queue;
+    };
+}
+
+std::vector<std::vector<unsigned short>> simplifyAnimatedMesh(const std::vector<unsigned short> &indices,
+                                                              const std::vector<unsigned short> &positions,
+                                                              const FrameView<const Vertex> &frames,
+                                                              const std::vector<size_t> &targets)
+{
+    std::vector<std::vector<unsigned short>> levels;
+    if (frames.frameCount() == 0) {
+        levels.assign(targets.size(), indices);
+        return levels;
+    }
+
+    Simplifier simplifier(indices, positions, frames);
+    for (size_t target : targets) {
+        while (simplifier.triangleCount() > target && simplifier.collapseNext()) {
+        }
+        levels.push_back(simplifier.triangleList());
+    }
+    return levels;
+}
@@ -72,12 +72,57 @@
 
 #ifndef STBI_NO_STDIO
 #include <stdio.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#endif
+#if defined(_WIN32) && !(defined(STBI_NO_STDIO) && defined(STBI_NO_THREADS))
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+#if !defined(_WIN32) && !(defined(STBI_NO_STDIO) && defined(STBI_NO_THREADS))
+#include <unistd.h>
+#endif
+#if !defined(_WIN32) && !defined(STBI_NO_THREADS)
+#include <pthread.h>
 #endif
 #include <stdlib.h>
 #include <memory.h>
 #include <assert.h>
 #include <stdarg.h>
 
+#if STBI_SIMD && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define STBI_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 kernels are compiled on their own and only installed when the cpu reports it, the rest of
+// the decoder stays at the baseline instruction set
+#if defined(STBI_SSE2) && (defined(__GNUC__) || defined(_MSC_VER))
+#define STBI_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define STBI_AVX2_FUNCTION
+#else
+#define STBI_AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+// the simd helpers have to inline into the AVX2 kernels, a call into SSE2 code from them costs
+// more than the kernel saves
+#ifdef _MSC_VER
+#define STBI_ALIGN16 __declspec(align(16))
+#define STBI_SIMD_INLINE __forceinline
+#else
+#define STBI_ALIGN16 __attribute__((aligned(16)))
+#define STBI_SIMD_INLINE __inline__ __attribute__((always_inline))
+#endif
+
 #ifndef _MSC_VER
   #ifdef __cplusplus
   #define __forceinline inline
@@ -172,13 +217,108 @@ static stbi_uc *hdr_to_ldr(float   *data, int x, int y, int comp);
 #endif
 
 #ifndef STBI_NO_STDIO
+// a whole file in memory, mapped read-only where the os can and read in one go otherwise, so
+// loading a path runs the decoders on their memory path instead of a stdio call per byte
+typedef struct
+{
+   uint8 *data;
+   int len;
+   int mapped;
+} stbi_file_bytes;
+
+static int open_file_bytes(stbi_file_bytes *b, char const *filename)
+{
+   FILE *f;
+   int capacity = 0, n;
+   b->data = NULL;
+   b->len = 0;
+   b->mapped = 0;
+
+#ifdef _WIN32
+   {
+      HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+      if (file != INVALID_HANDLE_VALUE) {
+         LARGE_INTEGER size;
+         if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart <= 0x7fffffff) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping) {
+               b->data = (uint8 *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+               CloseHandle(mapping);
+            }
+            if (b->data) {
+               b->len = (int) size.QuadPart;
+               b->mapped = 1;
+            }
+         }
+         // the view keeps its own reference to the mapping and the file
+         CloseHandle(file);
+         if (b->mapped) return 1;
+      }
+   }
+#else
+   {
+      int fd = open(filename, O_RDONLY);
+      if (fd >= 0) {
+         struct stat status;
+         if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0 && status.st_size <= 0x7fffffff) {
+            void *mapping = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+               b->data = (uint8 *) mapping;
+               b->len = (int) status.st_size;
+               b->mapped = 1;
+            }
+         }
+         // the mapping keeps its own reference to the file
+         close(fd);
+         if (b->mapped) return 1;
+      }
+   }
+#endif
+
+   // pipes, empty files and anything else the os won't map are read whole
+   f = fopen(filename, "rb");
+   if (!f) return e("can't fopen", "Unable to open file");
+   for (;;) {
+      if (b->len == capacity) {
+         uint8 *p = NULL;
+         if (capacity < 0x40000000)
+            p = (uint8 *) realloc(b->data, capacity ? capacity*2 : 65536);
+         if (!p) {
+            free(b->data);
+            fclose(f);
+            return e("outofmem", "Out of memory");
+         }
+         b->data = p;
+         capacity = capacity ? capacity*2 : 65536;
+      }
+      n = (int) fread(b->data + b->len, 1, capacity - b->len, f);
+      if (n <= 0) break;
+      b->len += n;
+   }
+   fclose(f);
+   return 1;
+}
+
+static void close_file_bytes(stbi_file_bytes *b)
+{
+   if (!b->mapped)
+      free(b->data);
+#ifdef _WIN32
+   else
+      UnmapViewOfFile(b->data);
+#else
+   else
+      munmap(b->data, b->len);
+#endif
+}
+
 unsigned char *stbi_load(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
-   FILE *f = fopen(filename, "rb");
+   stbi_file_bytes b;
    unsigned char *result;
-   if (!f) return epuc("can't fopen", "Unable to open file");
-   result = stbi_load_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   if (!open_file_bytes(&b, filename)) return NULL;
+   result = stbi_load_from_memory(b.data, b.len, x,y,comp,req_comp);
+   close_file_bytes(&b);
    return result;
 }
 
@@ -243,16 +383,83 @@ unsigned char *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int
    return epuc("unknown image type", "Image not of any known type, or corrupt");
 }
 
+// the shift of a scaled load, -1 for a scale other than 1, 2, 4 or 8
+static int scale_to_shift(int scale)
+{
+   switch (scale) {
+      case 1: return 0;
+      case 2: return 1;
+      case 4: return 2;
+      case 8: return 3;
+   }
+   return -1;
+}
+
+// average every block of 1<<shift pixels a side into one pixel; the blocks on the
+// right and bottom edge average the pixels they have, so the size rounds up
+static stbi_uc *box_reduce(stbi_uc *data, int *x, int *y, int comp, int shift)
+{
+   int i,j,k,u,v,nx,ny;
+   stbi_uc *out;
+   if (!shift) return data;
+   nx = (*x + (1 << shift)-1) >> shift;
+   ny = (*y + (1 << shift)-1) >> shift;
+   out = (stbi_uc *) malloc(nx * ny * comp);
+   if (!out) { free(data); return epuc("outofmem", "Out of memory"); }
+   for (j=0; j < ny; ++j) {
+      int y0 = j << shift, y1 = y0 + (1 << shift) < *y ? y0 + (1 << shift) : *y;
+      for (i=0; i < nx; ++i) {
+         int x0 = i << shift, x1 = x0 + (1 << shift) < *x ? x0 + (1 << shift) : *x;
+         int count = (x1-x0) * (y1-y0);
+         for (k=0; k < comp; ++k) {
+            int sum = count >> 1;
+            for (v=y0; v < y1; ++v)
+               for (u=x0; u < x1; ++u)
+                  sum += data[(v * *x + u) * comp + k];
+            out[(j * nx + i) * comp + k] = (stbi_uc) (sum / count);
+         }
+      }
+   }
+   free(data);
+   *x = nx;
+   *y = ny;
+   return out;
+}
+
+unsigned char *stbi_load_from_memory_scaled(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, int scale)
+{
+   unsigned char *data;
+   int shift = scale_to_shift(scale);
+   if (shift < 0) return epuc("bad scale", "Scale must be 1, 2, 4 or 8");
+   if (stbi_jpeg_test_memory(buffer,len))
+      return stbi_jpeg_load_from_memory_scaled(buffer,len,x,y,comp,req_comp,scale);
+   data = stbi_load_from_memory(buffer,len,x,y,comp,req_comp);
+   if (!data) return NULL;
+   return box_reduce(data, x, y, req_comp ? req_comp : *comp, shift);
+}
+
+#ifndef STBI_NO_STDIO
+unsigned char *stbi_load_scaled(char const *filename, int *x, int *y, int *comp, int req_comp, int scale)
+{
+   stbi_file_bytes b;
+   unsigned char *result;
+   if (!open_file_bytes(&b, filename)) return NULL;
+   result = stbi_load_from_memory_scaled(b.data, b.len, x,y,comp,req_comp,scale);
+   close_file_bytes(&b);
+   return result;
+}
+#endif
+
 #ifndef STBI_NO_HDR
 
 #ifndef STBI_NO_STDIO
 float *stbi_loadf(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
-   FILE *f = fopen(filename, "rb");
+   stbi_file_bytes b;
    float *result;
-   if (!f) return epf("can't fopen", "Unable to open file");
-   result = stbi_loadf_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   if (!open_file_bytes(&b, filename)) return NULL;
+   result = stbi_loadf_from_memory(b.data, b.len, x,y,comp,req_comp);
+   close_file_bytes(&b);
    return result;
 }
 
@@ -412,7 +619,8 @@ static void skip(stbi *s, int n)
       fseek(s->img_file, n, SEEK_CUR);
    else
 #endif
-      s->img_buffer += n;
+      // stop at the end of the buffer like a seek past the end of a file
+      s->img_buffer += n < s->img_buffer_end - s->img_buffer ? n : s->img_buffer_end - s->img_buffer;
 }
 
 static int get16(stbi *s)
@@ -447,6 +655,12 @@ static void getn(stbi *s, stbi_uc *buffer, int n)
       return;
    }
 #endif
+   // a truncated buffer reads as zeros past its end, the same as get8
+   if (n > s->img_buffer_end - s->img_buffer) {
+      int left = (int) (s->img_buffer_end - s->img_buffer);
+      memset(buffer + left, 0, n - left);
+      n = left;
+   }
    memcpy(buffer, s->img_buffer, n);
    s->img_buffer += n;
 }
@@ -556,6 +770,187 @@ static stbi_uc *hdr_to_ldr(float   *data, int x, int y, int comp)
 }
 #endif
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  worker threads
+//
+//    a decode hands out numbered tasks, the calling thread and up to
+//    stbi_thread_count()-1 threads started for the call take the next
+//    one until none are left, so uneven tasks still balance
+
+// runs init exactly once, a thread that comes in while another runs it
+// waits until it is done
+#if defined(STBI_AVX2) || !defined(STBI_NO_THREADS)
+#ifdef STBI_NO_THREADS
+typedef int stbi_once;
+#define STBI_ONCE_INIT 0
+
+static void call_once(stbi_once *once, void (*init)(void))
+{
+   if (!*once) {
+      *once = 1;
+      init();
+   }
+}
+#elif defined(_WIN32)
+typedef INIT_ONCE stbi_once;
+#define STBI_ONCE_INIT INIT_ONCE_STATIC_INIT
+
+static BOOL CALLBACK once_callback(PINIT_ONCE once, PVOID init, PVOID *context)
+{
+   (*(void (**)(void)) init)();
+   return TRUE;
+}
+
+static void call_once(stbi_once *once, void (*init)(void))
+{
+   InitOnceExecuteOnce(once, once_callback, &init, NULL);
+}
+#else
+typedef pthread_once_t stbi_once;
+#define STBI_ONCE_INIT PTHREAD_ONCE_INIT
+
+static void call_once(stbi_once *once, void (*init)(void))
+{
+   pthread_once(once, init);
+}
+#endif
+#endif
+
+typedef void (*stbi_task)(void *context, int index);
+
+typedef struct
+{
+   stbi_task run;
+   void *context;
+   int count;
+   volatile long next;
+} stbi_tasks;
+
+#ifndef STBI_NO_THREADS
+#define STBI_MAX_THREADS 64
+
+static int stbi_threads = 0; // 0 is one per cpu
+
+void stbi_set_thread_count(int count)
+{
+   stbi_threads = count < 0 ? 0 : count;
+}
+
+static stbi_once stbi_cpus_counted = STBI_ONCE_INIT;
+static int stbi_cpus;
+
+static void count_cpus(void)
+{
+#ifdef _WIN32
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   stbi_cpus = (int) info.dwNumberOfProcessors;
+#else
+   stbi_cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+   if (stbi_cpus < 1) stbi_cpus = 1;
+}
+
+int stbi_thread_count(void)
+{
+   int count = stbi_threads;
+   if (count == 0) {
+      call_once(&stbi_cpus_counted, count_cpus);
+      count = stbi_cpus;
+   }
+   return count < STBI_MAX_THREADS ? count : STBI_MAX_THREADS;
+}
+
+static int next_task(stbi_tasks *t)
+{
+#ifdef _WIN32
+   return (int) InterlockedIncrement(&t->next) - 1;
+#else
+   return (int) __sync_fetch_and_add(&t->next, 1);
+#endif
+}
+#else
+static int next_task(stbi_tasks *t)
+{
+   return (int) t->next++;
+}
+#endif
+
+static void drain_tasks(stbi_tasks *t)
+{
+   int i;
+   while ((i = next_task(t)) < t->count)
+      t->run(t->context, i);
+}
+
+#ifndef STBI_NO_THREADS
+#ifdef _WIN32
+static DWORD WINAPI task_thread(LPVOID t)
+{
+   drain_tasks((stbi_tasks *) t);
+   return 0;
+}
+#else
+static void *task_thread(void *t)
+{
+   drain_tasks((stbi_tasks *) t);
+   return NULL;
+}
+#endif
+#endif
+
+// runs run(context, i) for every i below count and returns once all have finished; a thread
+// that can't be started leaves its share to the others
+static void run_tasks(stbi_task run, void *context, int count)
+{
+   stbi_tasks t;
+#ifndef STBI_NO_THREADS
+   int i, started = 0, threads = stbi_thread_count();
+   #ifdef _WIN32
+   HANDLE handles[STBI_MAX_THREADS];
+   #else
+   pthread_t handles[STBI_MAX_THREADS];
+   #endif
+#endif
+   t.run = run;
+   t.context = context;
+   t.count = count;
+   t.next = 0;
+#ifndef STBI_NO_THREADS
+   if (threads > count) threads = count;
+   for (i=1; i < threads; ++i) {
+      #ifdef _WIN32
+      handles[started] = CreateThread(NULL, 0, task_thread, &t, 0, NULL);
+      if (!handles[started]) break;
+      #else
+      if (pthread_create(&handles[started], NULL, task_thread, &t) != 0) break;
+      #endif
+      ++started;
+   }
+#endif
+   drain_tasks(&t);
+#ifndef STBI_NO_THREADS
+   for (i=0; i < started; ++i) {
+      #ifdef _WIN32
+      WaitForSingleObject(handles[i], INFINITE);
+      CloseHandle(handles[i]);
+      #else
+      pthread_join(handles[i], NULL);
+      #endif
+   }
+#endif
+}
+
+static int tasks_wanted(void)
+{
+#ifndef STBI_NO_THREADS
+   return stbi_thread_count();
+#else
+   return 1;
+#endif
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  "baseline" JPEG/JFIF decoder (not actually fully baseline implementation)
@@ -601,6 +996,9 @@ typedef struct
 {
    #if STBI_SIMD
    unsigned short dequant2[4][64];
+   // the kernels of this decode, picked before any worker starts
+   stbi_idct_8x8 idct;
+   stbi_YCbCr_to_RGB_run YCbCr;
    #endif
    stbi s;
    huffman huff_dc[4];
@@ -622,6 +1020,7 @@ typedef struct
       int dc_pred;
 
       int x,y,w2,h2;
+      int xshift,yshift; // a scaled decode transforms its blocks to 8 >> xshift by 8 >> yshift
       uint8 *data;
       void *raw_data;
       uint8 *linebuf;
@@ -634,6 +1033,8 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int scale_shift; // the output is the image reduced by 1 << scale_shift
+   int kernel_level; // simd level of the upsamplers and reduced IDCTs, read when the decode starts
 } jpeg;
 
 static int build_huffman(huffman *h, int *count)
@@ -684,9 +1085,11 @@ static void grow_buffer_unsafe(jpeg *j)
       if (b == 0xff) {
          int c = get8(&j->s);
          if (c != 0) {
+            // the scan ends here, pad with zeros like every byte after it so a
+            // code never reads past the bits it has
             j->marker = (unsigned char) c;
             j->nomore = 1;
-            return;
+            b = 0;
          }
       }
       j->code_buffer = (j->code_buffer << 8) | b;
@@ -976,7 +1379,293 @@ static void idct_block(uint8 *out, int out_stride, short data[64], unsigned shor
       o[4] = clamp((x3-t0) >> 17);
    }
 }
-static stbi_idct_8x8 stbi_idct_installed = idct_block;
+
+#ifdef STBI_SSE2
+// IDCT_1D with every product of a sum multiplied out, so all of them are taken on the inputs
+// themselves and pair up for pmaddwd: each output is madd(s0,s4) or madd(s2,s6) on the even side
+// and madd(s1,s7) + madd(s3,s5) on the odd side. Integer math wraps the same in any order, so
+// the results are exactly idct_block's as long as the inputs fit the 16 bit lanes.
+#define IDCT_C0   f2f(0.5411961f)
+#define IDCT_C1   f2f(-1.847759065f)
+#define IDCT_C2   f2f( 0.765366865f)
+#define IDCT_C5   f2f( 1.175875602f)
+#define IDCT_A0   f2f( 0.298631336f)
+#define IDCT_A1   f2f( 2.053119869f)
+#define IDCT_A2   f2f( 3.072711026f)
+#define IDCT_A3   f2f( 1.501321110f)
+#define IDCT_B1   f2f(-0.899976223f)
+#define IDCT_B2   f2f(-2.562915447f)
+#define IDCT_B3   f2f(-1.961570560f)
+#define IDCT_B4   f2f(-0.390180644f)
+
+// a*lo + b*hi for every interleaved a,b pair
+#define IDCT_PAIR(lo,hi)   _mm_setr_epi16((short) (lo), (short) (hi), (short) (lo), (short) (hi), \
+                                          (short) (lo), (short) (hi), (short) (lo), (short) (hi))
+
+// the eight outputs of IDCT_1D plus bias for four lanes of interleaved input pairs
+static STBI_SIMD_INLINE void idct_pairs_sse2(__m128i x[8], __m128i s04, __m128i s26, __m128i s17, __m128i s35, __m128i bias)
+{
+   __m128i t0 = _mm_add_epi32(_mm_madd_epi16(s04, IDCT_PAIR(4096, 4096)), bias);
+   __m128i t1 = _mm_add_epi32(_mm_madd_epi16(s04, IDCT_PAIR(4096, -4096)), bias);
+   __m128i t2 = _mm_madd_epi16(s26, IDCT_PAIR(IDCT_C0, IDCT_C0+IDCT_C1));
+   __m128i t3 = _mm_madd_epi16(s26, IDCT_PAIR(IDCT_C0+IDCT_C2, IDCT_C0));
+   __m128i x0 = _mm_add_epi32(t0, t3);
+   __m128i x3 = _mm_sub_epi32(t0, t3);
+   __m128i x1 = _mm_add_epi32(t1, t2);
+   __m128i x2 = _mm_sub_epi32(t1, t2);
+   __m128i o0 = _mm_add_epi32(_mm_madd_epi16(s17, IDCT_PAIR(IDCT_B1+IDCT_C5, IDCT_A0+IDCT_B1+IDCT_B3+IDCT_C5)),
+                              _mm_madd_epi16(s35, IDCT_PAIR(IDCT_B3+IDCT_C5, IDCT_C5)));
+   __m128i o1 = _mm_add_epi32(_mm_madd_epi16(s17, IDCT_PAIR(IDCT_B4+IDCT_C5, IDCT_C5)),
+                              _mm_madd_epi16(s35, IDCT_PAIR(IDCT_B2+IDCT_C5, IDCT_A1+IDCT_B2+IDCT_B4+IDCT_C5)));
+   __m128i o2 = _mm_add_epi32(_mm_madd_epi16(s17, IDCT_PAIR(IDCT_C5, IDCT_B3+IDCT_C5)),
+                              _mm_madd_epi16(s35, IDCT_PAIR(IDCT_A2+IDCT_B2+IDCT_B3+IDCT_C5, IDCT_B2+IDCT_C5)));
+   __m128i o3 = _mm_add_epi32(_mm_madd_epi16(s17, IDCT_PAIR(IDCT_A3+IDCT_B1+IDCT_B4+IDCT_C5, IDCT_B1+IDCT_C5)),
+                              _mm_madd_epi16(s35, IDCT_PAIR(IDCT_C5, IDCT_B4+IDCT_C5)));
+   x[0] = _mm_add_epi32(x0, o3);
+   x[7] = _mm_sub_epi32(x0, o3);
+   x[1] = _mm_add_epi32(x1, o2);
+   x[6] = _mm_sub_epi32(x1, o2);
+   x[2] = _mm_add_epi32(x2, o1);
+   x[5] = _mm_sub_epi32(x2, o1);
+   x[3] = _mm_add_epi32(x3, o0);
+   x[4] = _mm_sub_epi32(x3, o0);
+}
+
+static STBI_SIMD_INLINE void transpose_8x8_sse2(__m128i r[8])
+{
+   __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]), a1 = _mm_unpackhi_epi16(r[0], r[1]);
+   __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]), a3 = _mm_unpackhi_epi16(r[2], r[3]);
+   __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]), a5 = _mm_unpackhi_epi16(r[4], r[5]);
+   __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]), a7 = _mm_unpackhi_epi16(r[6], r[7]);
+   __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+   __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+   __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+   __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+   r[0] = _mm_unpacklo_epi64(b0, b4); r[1] = _mm_unpackhi_epi64(b0, b4);
+   r[2] = _mm_unpacklo_epi64(b1, b5); r[3] = _mm_unpackhi_epi64(b1, b5);
+   r[4] = _mm_unpacklo_epi64(b2, b6); r[5] = _mm_unpackhi_epi64(b2, b6);
+   r[6] = _mm_unpacklo_epi64(b3, b7); r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+// dequantizes the rows of a block into 16 bit lanes, returns nonzero if a product didn't fit
+static STBI_SIMD_INLINE int dequantize_rows_sse2(__m128i row[8], short data[64], unsigned short *dequantize)
+{
+   __m128i overflow = _mm_setzero_si128();
+   int i;
+   for (i=0; i < 8; ++i) {
+      __m128i d = _mm_loadu_si128((__m128i const *) (data + i*8));
+      __m128i q = _mm_loadu_si128((__m128i const *) (dequantize + i*8));
+      row[i] = _mm_mullo_epi16(d, q);
+      // the product fits when its high half is only the sign of the low half
+      overflow = _mm_or_si128(overflow, _mm_xor_si128(_mm_mulhi_epi16(d, q), _mm_srai_epi16(row[i], 15)));
+   }
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(overflow, _mm_setzero_si128())) != 0xffff;
+}
+
+// packs 32 bit lanes to 16 bits, out of range ones are flagged in overflow
+static STBI_SIMD_INLINE __m128i pack_checked_sse2(__m128i lo, __m128i hi, __m128i *overflow)
+{
+   __m128i half = _mm_set1_epi32(0x8000);
+   *overflow = _mm_or_si128(*overflow, _mm_or_si128(_mm_add_epi32(lo, half), _mm_add_epi32(hi, half)));
+   return _mm_packs_epi32(lo, hi);
+}
+
+// stores eight rows of 16 bit results clamped to 0..255
+static STBI_SIMD_INLINE void store_rows_sse2(uint8 *out, int out_stride, __m128i r[8])
+{
+   int i;
+   for (i=0; i < 8; i += 2) {
+      __m128i bytes = _mm_packus_epi16(r[i], r[i+1]);
+      _mm_storel_epi64((__m128i *) (out + i*out_stride), bytes);
+      _mm_storel_epi64((__m128i *) (out + (i+1)*out_stride), _mm_unpackhi_epi64(bytes, bytes));
+   }
+}
+
+// the column pass leaves 2 extra bits like idct_block's, the row pass folds clamp()'s +128 into
+// its rounding bias
+#define IDCT_BIAS_COLUMNS   512
+#define IDCT_BIAS_ROWS      (65536 + (128 << 17))
+
+// idct_block on eight columns, then eight rows, at a time. Blocks whose dequantized coefficients
+// or column results don't fit 16 bits are left to idct_block, valid jpegs practically never
+// have them.
+static void idct_sse2(uint8 *out, int out_stride, short data[64], unsigned short *dequantize)
+{
+   __m128i r[8], lo[8], hi[8], overflow = _mm_setzero_si128();
+   int i, pass;
+
+   if (dequantize_rows_sse2(r, data, dequantize)) {
+      idct_block(out, out_stride, data, dequantize);
+      return;
+   }
+
+   for (pass=0; pass < 2; ++pass) {
+      __m128i bias = _mm_set1_epi32(pass ? IDCT_BIAS_ROWS : IDCT_BIAS_COLUMNS);
+      idct_pairs_sse2(lo, _mm_unpacklo_epi16(r[0], r[4]), _mm_unpacklo_epi16(r[2], r[6]),
+                      _mm_unpacklo_epi16(r[1], r[7]), _mm_unpacklo_epi16(r[3], r[5]), bias);
+      idct_pairs_sse2(hi, _mm_unpackhi_epi16(r[0], r[4]), _mm_unpackhi_epi16(r[2], r[6]),
+                      _mm_unpackhi_epi16(r[1], r[7]), _mm_unpackhi_epi16(r[3], r[5]), bias);
+      if (pass == 0) {
+         for (i=0; i < 8; ++i)
+            r[i] = pack_checked_sse2(_mm_srai_epi32(lo[i], 10), _mm_srai_epi32(hi[i], 10), &overflow);
+         if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(overflow, 16), _mm_setzero_si128())) != 0xffff) {
+            idct_block(out, out_stride, data, dequantize);
+            return;
+         }
+      } else {
+         for (i=0; i < 8; ++i)
+            r[i] = _mm_packs_epi32(_mm_srai_epi32(lo[i], 17), _mm_srai_epi32(hi[i], 17));
+      }
+      transpose_8x8_sse2(r);
+   }
+   store_rows_sse2(out, out_stride, r);
+}
+#endif
+
+#ifdef STBI_AVX2
+// idct_sse2 with all eight lanes of a pass in one register
+#define IDCT_PAIR256(lo,hi)   _mm256_set1_epi32((int) (((unsigned int) (hi) << 16) | ((unsigned int) (lo) & 0xffff)))
+
+STBI_AVX2_FUNCTION static STBI_SIMD_INLINE void idct_pairs_avx2(__m256i x[8], __m256i s04, __m256i s26, __m256i s17, __m256i s35, __m256i bias)
+{
+   __m256i t0 = _mm256_add_epi32(_mm256_madd_epi16(s04, IDCT_PAIR256(4096, 4096)), bias);
+   __m256i t1 = _mm256_add_epi32(_mm256_madd_epi16(s04, IDCT_PAIR256(4096, -4096)), bias);
+   __m256i t2 = _mm256_madd_epi16(s26, IDCT_PAIR256(IDCT_C0, IDCT_C0+IDCT_C1));
+   __m256i t3 = _mm256_madd_epi16(s26, IDCT_PAIR256(IDCT_C0+IDCT_C2, IDCT_C0));
+   __m256i x0 = _mm256_add_epi32(t0, t3);
+   __m256i x3 = _mm256_sub_epi32(t0, t3);
+   __m256i x1 = _mm256_add_epi32(t1, t2);
+   __m256i x2 = _mm256_sub_epi32(t1, t2);
+   __m256i o0 = _mm256_add_epi32(_mm256_madd_epi16(s17, IDCT_PAIR256(IDCT_B1+IDCT_C5, IDCT_A0+IDCT_B1+IDCT_B3+IDCT_C5)),
+                                 _mm256_madd_epi16(s35, IDCT_PAIR256(IDCT_B3+IDCT_C5, IDCT_C5)));
+   __m256i o1 = _mm256_add_epi32(_mm256_madd_epi16(s17, IDCT_PAIR256(IDCT_B4+IDCT_C5, IDCT_C5)),
+                                 _mm256_madd_epi16(s35, IDCT_PAIR256(IDCT_B2+IDCT_C5, IDCT_A1+IDCT_B2+IDCT_B4+IDCT_C5)));
+   __m256i o2 = _mm256_add_epi32(_mm256_madd_epi16(s17, IDCT_PAIR256(IDCT_C5, IDCT_B3+IDCT_C5)),
+                                 _mm256_madd_epi16(s35, IDCT_PAIR256(IDCT_A2+IDCT_B2+IDCT_B3+IDCT_C5, IDCT_B2+IDCT_C5)));
+   __m256i o3 = _mm256_add_epi32(_mm256_madd_epi16(s17, IDCT_PAIR256(IDCT_A3+IDCT_B1+IDCT_B4+IDCT_C5, IDCT_B1+IDCT_C5)),
+                                 _mm256_madd_epi16(s35, IDCT_PAIR256(IDCT_C5, IDCT_B4+IDCT_C5)));
+   x[0] = _mm256_add_epi32(x0, o3);
+   x[7] = _mm256_sub_epi32(x0, o3);
+   x[1] = _mm256_add_epi32(x1, o2);
+   x[6] = _mm256_sub_epi32(x1, o2);
+   x[2] = _mm256_add_epi32(x2, o1);
+   x[5] = _mm256_sub_epi32(x2, o1);
+   x[3] = _mm256_add_epi32(x3, o0);
+   x[4] = _mm256_sub_epi32(x3, o0);
+}
+
+// lanes 0..3 of a row in the low half, 4..7 in the high one, so the in-lane unpacks pair up
+// all eight
+STBI_AVX2_FUNCTION static STBI_SIMD_INLINE __m256i spread_row_avx2(__m128i r)
+{
+   return _mm256_permute4x64_epi64(_mm256_castsi128_si256(r), _MM_SHUFFLE(1,1,0,0));
+}
+
+STBI_AVX2_FUNCTION static void idct_avx2(uint8 *out, int out_stride, short data[64], unsigned short *dequantize)
+{
+   __m128i r[8];
+   __m256i x[8], overflow = _mm256_setzero_si256(), half = _mm256_set1_epi32(0x8000);
+   int i, pass;
+
+   if (dequantize_rows_sse2(r, data, dequantize)) {
+      idct_block(out, out_stride, data, dequantize);
+      return;
+   }
+
+   for (pass=0; pass < 2; ++pass) {
+      __m256i s[8];
+      for (i=0; i < 8; ++i)
+         s[i] = spread_row_avx2(r[i]);
+      idct_pairs_avx2(x, _mm256_unpacklo_epi16(s[0], s[4]), _mm256_unpacklo_epi16(s[2], s[6]),
+                      _mm256_unpacklo_epi16(s[1], s[7]), _mm256_unpacklo_epi16(s[3], s[5]),
+                      _mm256_set1_epi32(pass ? IDCT_BIAS_ROWS : IDCT_BIAS_COLUMNS));
+      for (i=0; i < 8; ++i) {
+         __m256i v = pass ? _mm256_srai_epi32(x[i], 17) : _mm256_srai_epi32(x[i], 10);
+         if (pass == 0)
+            overflow = _mm256_or_si256(overflow, _mm256_add_epi32(v, half));
+         r[i] = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+      }
+      if (pass == 0 && !_mm256_testz_si256(overflow, _mm256_set1_epi32((int) 0xffff0000))) {
+         idct_block(out, out_stride, data, dequantize);
+         return;
+      }
+      transpose_8x8_sse2(r);
+   }
+   store_rows_sse2(out, out_stride, r);
+}
+
+static int stbi_cpu_has_avx2(void)
+{
+#ifdef _MSC_VER
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7)
+      return 0;
+   __cpuid(info, 1);
+   // the os has to save the ymm registers too
+   if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+      return 0;
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) != 0;
+#else
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef STBI_AVX2
+static stbi_once stbi_simd_detected = STBI_ONCE_INIT;
+static int stbi_simd_level;
+
+static void detect_simd(void)
+{
+   stbi_simd_level = stbi_cpu_has_avx2() ? STBI_simd_avx2 : STBI_simd_sse2;
+}
+#endif
+
+int stbi_simd_support(void)
+{
+#if defined(STBI_AVX2)
+   call_once(&stbi_simd_detected, detect_simd);
+   return stbi_simd_level;
+#elif defined(STBI_SSE2)
+   return STBI_simd_sse2;
+#else
+   return STBI_simd_scalar;
+#endif
+}
+
+// the level of the built-in upsamplers and reduced IDCTs, which are picked per call rather
+// than installed; -1 until stbi_simd_install, which means the widest the cpu runs
+static int stbi_kernel_level = -1;
+
+static int kernel_level(void)
+{
+   return stbi_kernel_level < 0 ? stbi_simd_support() : stbi_kernel_level;
+}
+
+static stbi_idct_8x8 idct_for_level(int level)
+{
+   if (level > stbi_simd_support())
+      level = stbi_simd_support();
+#ifdef STBI_AVX2
+   if (level == STBI_simd_avx2) return idct_avx2;
+#endif
+#ifdef STBI_SSE2
+   if (level >= STBI_simd_sse2) return idct_sse2;
+#endif
+   return idct_block;
+}
+
+// NULL until stbi_install_idct or stbi_simd_install, decoding only ever reads it
+static stbi_idct_8x8 stbi_idct_installed = NULL;
+
+// the installed idct, or the widest built-in one the cpu runs
+static stbi_idct_8x8 idct_installed(void)
+{
+   return stbi_idct_installed ? stbi_idct_installed : idct_for_level(stbi_simd_support());
+}
 
 extern void stbi_install_idct(stbi_idct_8x8 func)
 {
@@ -984,6 +1673,172 @@ extern void stbi_install_idct(stbi_idct_8x8 func)
 }
 #endif
 
+// reduced size IDCTs: weight[m][u] is the 1D basis function u, C(u)/2 * cos((2x+1)u pi/16),
+// averaged over the pixels x that output pixel m covers and scaled by 1<<12, so every output
+// is the box filter of the full size block taken straight from the coefficients. The full size
+// one is there for a subsampled component that keeps all its samples along one axis only.
+static short idct_box_8[8][8] =
+{
+   { 1448,  2009,  1892,  1703,  1448,  1138,   784,   400 },
+   { 1448,  1703,   784,  -400, -1448, -2009, -1892, -1138 },
+   { 1448,  1138,  -784, -2009, -1448,   400,  1892,  1703 },
+   { 1448,   400, -1892, -1138,  1448,  1703,  -784, -2009 },
+   { 1448,  -400, -1892,  1138,  1448, -1703,  -784,  2009 },
+   { 1448, -1138,  -784,  2009, -1448,  -400,  1892, -1703 },
+   { 1448, -1703,   784,   400, -1448,  2009, -1892,  1138 },
+   { 1448, -2009,  1892, -1703,  1448, -1138,   784,  -400 },
+};
+
+static short idct_box_4[4][8] =
+{
+   { 1448,  1856,  1338,   652, 0,  -435,  -554,  -369 },
+   { 1448,   769, -1338, -1573, 0,  1051,   554,  -153 },
+   { 1448,  -769, -1338,  1573, 0, -1051,   554,   153 },
+   { 1448, -1856,  1338,  -652, 0,   435,  -554,   369 },
+};
+
+static short idct_box_2[2][8] =
+{
+   { 1448,  1312, 0,  -461, 0,   308, 0,  -261 },
+   { 1448, -1312, 0,   461, 0,  -308, 0,   261 },
+};
+
+static short idct_box_1[1][8] =
+{
+   { 1448, 0, 0, 0, 0, 0, 0, 0 },
+};
+
+static short (*idct_box[4])[8] = { idct_box_8, idct_box_4, idct_box_2, idct_box_1 };
+
+// the 8x8 block reduced by 1<<xshift across and 1<<yshift down, 'out' gets
+// 8 >> xshift by 8 >> yshift samples. Every basis function is even or odd about
+// the middle of the block, so each pair of outputs mirrored about it is the sum
+// and the difference of the even and the odd terms.
+static void idct_scaled(uint8 *out, int out_stride, short data[64], uint8 *dequantize, int xshift, int yshift)
+{
+   int i,j,k,last,cols=0,nx = 8 >> xshift,ny = 8 >> yshift;
+   int val[8*8],c[8],*v,even,odd;
+   short (*wx)[8] = idct_box[xshift], (*wy)[8] = idct_box[yshift];
+   uint8 *o;
+
+   if (xshift == 3 && yshift == 3) {
+      // only the dc term is left, the mean of the block
+      out[0] = clamp((data[0] * dequantize[0] + 4) >> 3);
+      return;
+   }
+
+   // columns, ny outputs each; 'cols' ends up past the last one that isn't zero
+   for (i=0; i < 8; ++i) {
+      for (last=7; last > 0 && data[last*8+i] == 0; --last);
+      if (last == 0 || ny == 1) {
+         int dcterm = (data[i] * dequantize[i] * wy[0][0] + 512) >> 10;
+         for (j=0; j < ny; ++j)
+            val[j*8+i] = dcterm;
+         if (dcterm) cols = i+1;
+         continue;
+      }
+      for (k=0; k <= last; ++k)
+         c[k] = data[k*8+i] * dequantize[k*8+i];
+      for (j=0; j < ny >> 1; ++j) {
+         even = odd = 0;
+         for (k=0; k <= last; k += 2) even += wy[j][k] * c[k];
+         for (k=1; k <= last; k += 2) odd  += wy[j][k] * c[k];
+         // constants scaled things up by 1<<12, keep 2 extra bits
+         val[j*8+i]        = (even + odd + 512) >> 10;
+         val[(ny-1-j)*8+i] = (even - odd + 512) >> 10;
+      }
+      cols = i+1;
+   }
+
+   // rows, nx outputs each; 1<<12 from the weights plus the 2 bits kept above
+   for (j=0, v=val, o=out; j < ny; ++j, v+=8, o+=out_stride) {
+      if (nx == 1) {
+         o[0] = clamp((wx[0][0] * v[0] + 8192) >> 14);
+         continue;
+      }
+      for (i=0; i < nx >> 1; ++i) {
+         even = odd = 0;
+         for (k=0; k < cols; k += 2) even += wx[i][k] * v[k];
+         for (k=1; k < cols; k += 2) odd  += wx[i][k] * v[k];
+         o[i]      = clamp((even + odd + 8192) >> 14);
+         o[nx-1-i] = clamp((even - odd + 8192) >> 14);
+      }
+   }
+}
+
+#ifdef STBI_SSE2
+// the four sums of the 32 bit lanes of a, b, c and d
+static STBI_SIMD_INLINE __m128i sum_lanes4_sse2(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+   __m128i ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+   __m128i cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+   return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+}
+
+// idct_scaled at 1/2 or 1/4 along both axes: the columns eight at a time with the even and
+// odd terms paired up for pmaddwd, then every row output a dot product with clamp()'s +128 in
+// its rounding bias. The results are
+// idct_scaled's exactly; returns 0 and leaves the block to it when a dequantized coefficient
+// or a column result doesn't fit 16 bits.
+static int idct_scaled_sse2(uint8 *out, int out_stride, short data[64], unsigned short *dequantize, int shift)
+{
+   __m128i r[8], v[4], w[4], overflow = _mm_setzero_si128();
+   __m128i s02l, s02h, s46l, s46h, s13l, s13h, s57l, s57h, bytes;
+   short (*box)[8] = idct_box[shift];
+   int j, n = 8 >> shift, px;
+
+   if (dequantize_rows_sse2(r, data, dequantize)) return 0;
+
+   s02l = _mm_unpacklo_epi16(r[0], r[2]); s02h = _mm_unpackhi_epi16(r[0], r[2]);
+   s46l = _mm_unpacklo_epi16(r[4], r[6]); s46h = _mm_unpackhi_epi16(r[4], r[6]);
+   s13l = _mm_unpacklo_epi16(r[1], r[3]); s13h = _mm_unpackhi_epi16(r[1], r[3]);
+   s57l = _mm_unpacklo_epi16(r[5], r[7]); s57h = _mm_unpackhi_epi16(r[5], r[7]);
+   for (j=0; j < n >> 1; ++j) {
+      __m128i e02 = IDCT_PAIR(box[j][0], box[j][2]), e46 = IDCT_PAIR(box[j][4], box[j][6]);
+      __m128i o13 = IDCT_PAIR(box[j][1], box[j][3]), o57 = IDCT_PAIR(box[j][5], box[j][7]);
+      __m128i bias = _mm_set1_epi32(512);
+      __m128i even_l = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(s02l, e02), _mm_madd_epi16(s46l, e46)), bias);
+      __m128i even_h = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(s02h, e02), _mm_madd_epi16(s46h, e46)), bias);
+      __m128i odd_l = _mm_add_epi32(_mm_madd_epi16(s13l, o13), _mm_madd_epi16(s57l, o57));
+      __m128i odd_h = _mm_add_epi32(_mm_madd_epi16(s13h, o13), _mm_madd_epi16(s57h, o57));
+      v[j] = pack_checked_sse2(_mm_srai_epi32(_mm_add_epi32(even_l, odd_l), 10),
+                               _mm_srai_epi32(_mm_add_epi32(even_h, odd_h), 10), &overflow);
+      v[n-1-j] = pack_checked_sse2(_mm_srai_epi32(_mm_sub_epi32(even_l, odd_l), 10),
+                                   _mm_srai_epi32(_mm_sub_epi32(even_h, odd_h), 10), &overflow);
+   }
+   if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(overflow, 16), _mm_setzero_si128())) != 0xffff)
+      return 0;
+
+   for (j=0; j < n; ++j)
+      w[j] = _mm_loadu_si128((__m128i const *) box[j]);
+   if (n == 4) {
+      for (j=0; j < 4; ++j) {
+         r[j] = sum_lanes4_sse2(_mm_madd_epi16(v[j], w[0]), _mm_madd_epi16(v[j], w[1]),
+                                _mm_madd_epi16(v[j], w[2]), _mm_madd_epi16(v[j], w[3]));
+         r[j] = _mm_srai_epi32(_mm_add_epi32(r[j], _mm_set1_epi32(8192 + (128 << 14))), 14);
+      }
+      bytes = _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3]));
+      for (j=0; j < 4; ++j) {
+         px = _mm_cvtsi128_si32(bytes);
+         memcpy(out + j*out_stride, &px, 4);
+         bytes = _mm_srli_si128(bytes, 4);
+      }
+   } else {
+      // both rows in one sum, the two outputs of the first row then the second
+      r[0] = sum_lanes4_sse2(_mm_madd_epi16(v[0], w[0]), _mm_madd_epi16(v[0], w[1]),
+                             _mm_madd_epi16(v[1], w[0]), _mm_madd_epi16(v[1], w[1]));
+      r[0] = _mm_srai_epi32(_mm_add_epi32(r[0], _mm_set1_epi32(8192 + (128 << 14))), 14);
+      bytes = _mm_packs_epi32(r[0], r[0]);
+      px = _mm_cvtsi128_si32(_mm_packus_epi16(bytes, bytes));
+      out[0] = (uint8) px;
+      out[1] = (uint8) (px >> 8);
+      out[out_stride] = (uint8) (px >> 16);
+      out[out_stride+1] = (uint8) (px >> 24);
+   }
+   return 1;
+}
+#endif
+
 #define MARKER_none  0xff
 // if there's a pending marker from the entropy stream, return that
 // otherwise, fetch from the stream and get a marker. if there's no
@@ -1017,72 +1872,184 @@ static void reset(jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
-static int parse_entropy_coded_data(jpeg *z)
+// transform a block of component n into its plane at 'out'
+__forceinline static void idct_to_plane(jpeg *z, int n, uint8 *out, short data[64])
 {
-   reset(z);
-   if (z->scan_n == 1) {
-      int i,j;
+   int xs = z->img_comp[n].xshift, ys = z->img_comp[n].yshift;
+   if (xs || ys) {
+      #ifdef STBI_SSE2
+      if (xs == ys && xs < 3 && z->kernel_level >= STBI_simd_sse2
+           && idct_scaled_sse2(out, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq], xs))
+         return;
+      #endif
+      idct_scaled(out, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq], xs, ys);
+   } else
       #if STBI_SIMD
-      __declspec(align(16))
+      z->idct(out, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
+      #else
+      idct_block(out, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
       #endif
-      short data[64];
+}
+
+// decode and transform the blocks of MCU (i,j), which in a non-interleaved scan is
+// the single block (i,j) of its component
+__forceinline static int decode_mcu(jpeg *z, int i, int j)
+{
+   STBI_ALIGN16 short data[64];
+   int k,x,y,bx,by;
+   if (z->scan_n == 1) {
       int n = z->order[0];
-      // non-interleaved data, we just need to process one block at a time,
-      // in trivial scanline order
-      // number of blocks to do just depends on how many actual "pixels" this
-      // component has, independent of interleaved MCU blocking and such
-      int w = (z->img_comp[n].x+7) >> 3;
-      int h = (z->img_comp[n].y+7) >> 3;
-      for (j=0; j < h; ++j) {
-         for (i=0; i < w; ++i) {
+      bx = 8 >> z->img_comp[n].xshift;
+      by = 8 >> z->img_comp[n].yshift;
+      if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
+      idct_to_plane(z, n, z->img_comp[n].data+z->img_comp[n].w2*j*by+i*bx, data);
+      return 1;
+   }
+   // scan an interleaved mcu... process scan_n components in order
+   for (k=0; k < z->scan_n; ++k) {
+      int n = z->order[k];
+      bx = 8 >> z->img_comp[n].xshift;
+      by = 8 >> z->img_comp[n].yshift;
+      // scan out an mcu's worth of this component; that's just determined
+      // by the basic H and V specified for the component
+      for (y=0; y < z->img_comp[n].v; ++y) {
+         for (x=0; x < z->img_comp[n].h; ++x) {
+            int x2 = (i*z->img_comp[n].h + x)*bx;
+            int y2 = (j*z->img_comp[n].v + y)*by;
             if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
-            #if STBI_SIMD
-            stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
-            #else
-            idct_block(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
-            #endif
-            // every data block is an MCU, so countdown the restart interval
-            if (--z->todo <= 0) {
-               if (z->code_bits < 24) grow_buffer_unsafe(z);
-               // if it's NOT a restart, then just bail, so we get corrupt data
-               // rather than no data
-               if (!RESTART(z->marker)) return 1;
-               reset(z);
-            }
+            idct_to_plane(z, n, z->img_comp[n].data+z->img_comp[n].w2*y2+x2, data);
          }
       }
-   } else { // interleaved!
-      int i,j,k,x,y;
-      short data[64];
-      for (j=0; j < z->img_mcu_y; ++j) {
-         for (i=0; i < z->img_mcu_x; ++i) {
-            // scan an interleaved mcu... process scan_n components in order
-            for (k=0; k < z->scan_n; ++k) {
-               int n = z->order[k];
-               // scan out an mcu's worth of this component; that's just determined
-               // by the basic H and V specified for the component
-               for (y=0; y < z->img_comp[n].v; ++y) {
-                  for (x=0; x < z->img_comp[n].h; ++x) {
-                     int x2 = (i*z->img_comp[n].h + x)*8;
-                     int y2 = (j*z->img_comp[n].v + y)*8;
-                     if (!decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+z->img_comp[n].ha, n)) return 0;
-                     #if STBI_SIMD
-                     stbi_idct_installed(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant2[z->img_comp[n].tq]);
-                     #else
-                     idct_block(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data, z->dequant[z->img_comp[n].tq]);
-                     #endif
-                  }
-               }
-            }
-            // after all interleaved components, that's an interleaved MCU,
-            // so now count down the restart interval
-            if (--z->todo <= 0) {
-               if (z->code_bits < 24) grow_buffer_unsafe(z);
-               // if it's NOT a restart, then just bail, so we get corrupt data
-               // rather than no data
-               if (!RESTART(z->marker)) return 1;
-               reset(z);
-            }
+   }
+   return 1;
+}
+
+// MCUs across a scan; non-interleaved data is processed one block at a time in
+// trivial scanline order, so the number of blocks just depends on how many actual
+// "pixels" the component has, independent of interleaved MCU blocking and such
+static int scan_mcus_x(jpeg *z)
+{
+   return z->scan_n == 1 ? (z->img_comp[z->order[0]].x+7) >> 3 : z->img_mcu_x;
+}
+
+static int scan_mcus_y(jpeg *z)
+{
+   return z->scan_n == 1 ? (z->img_comp[z->order[0]].y+7) >> 3 : z->img_mcu_y;
+}
+
+// restart intervals of one scan found by scanning ahead for their RST markers,
+// each one is entropy coded on its own so they decode on separate threads
+typedef struct
+{
+   jpeg *z;
+   uint8 **start;  // first byte of interval k, its end is the marker before start[k+1]
+   uint8 **end;
+   int intervals, per_task, mcus;
+   volatile int failed;
+} stbi_restart_intervals;
+
+static void decode_intervals_task(void *context, int index)
+{
+   stbi_restart_intervals *r = (stbi_restart_intervals *) context;
+   // a private copy of the decoder for its bit buffer and dc predictions,
+   // the component planes are shared and every interval writes its own blocks
+   jpeg z = *r->z;
+   int w = scan_mcus_x(&z);
+   int k, m, first = index * r->per_task;
+   int last = first + r->per_task < r->intervals ? first + r->per_task : r->intervals;
+   for (k=first; k < last; ++k) {
+      int m_end = (k+1) * z.restart_interval < r->mcus ? (k+1) * z.restart_interval : r->mcus;
+      z.s.img_buffer = r->start[k];
+      z.s.img_buffer_end = r->end[k];
+      reset(&z);
+      for (m=k * z.restart_interval; m < m_end; ++m) {
+         if (r->failed) return;
+         if (!decode_mcu(&z, m % w, m / w)) { r->failed = 1; return; }
+      }
+   }
+}
+
+// decode the scan's restart intervals in parallel when the entropy coded data is
+// in memory and every interval ends at its RST marker, returns -1 to leave a scan
+// that doesn't qualify to the serial decoder
+static int parse_restart_intervals(jpeg *z)
+{
+   stbi_restart_intervals r;
+   uint8 *p, *end;
+   int k, tasks;
+
+#ifndef STBI_NO_STDIO
+   if (z->s.img_file) return -1;
+#endif
+   if (!z->restart_interval || tasks_wanted() < 2) return -1;
+   r.mcus = scan_mcus_x(z) * scan_mcus_y(z);
+   r.intervals = (r.mcus + z->restart_interval-1) / z->restart_interval;
+   if (r.intervals < 2) return -1;
+
+   r.start = (uint8 **) malloc(r.intervals * 2 * sizeof(uint8 *));
+   if (!r.start) return -1;
+   r.end = r.start + r.intervals;
+
+   // the entropy coded data only holds 0xff followed by 0 for a literal 0xff or a
+   // restart marker, anything else ends the scan
+   k = 0;
+   p = z->s.img_buffer;
+   end = z->s.img_buffer_end;
+   r.start[0] = p;
+   for (;;) {
+      p = (uint8 *) memchr(p, 0xff, end - p);
+      if (!p || p+1 >= end) { p = end; break; }
+      if (p[1] == 0) { p += 2; continue; }
+      if (!RESTART(p[1])) break;
+      if (k+1 == r.intervals) { k = -1; break; } // more markers than intervals
+      r.end[k++] = p;
+      p += 2;
+      r.start[k] = p;
+   }
+   if (k+1 != r.intervals) {
+      // missing or extra markers, the serial decoder handles those the way it always has
+      free(r.start);
+      return -1;
+   }
+   r.end[k] = p;
+
+   r.z = z;
+   r.failed = 0;
+   // a few tasks per thread so one slow interval doesn't hold up the rest
+   tasks = tasks_wanted() * 4;
+   if (tasks > r.intervals) tasks = r.intervals;
+   r.per_task = (r.intervals + tasks-1) / tasks;
+   run_tasks(decode_intervals_task, &r, (r.intervals + r.per_task-1) / r.per_task);
+   free(r.start);
+   if (r.failed) return 0;
+
+   // carry on with the marker that ended the scan
+   z->s.img_buffer = p;
+   z->marker = MARKER_none;
+   return 1;
+}
+
+static int parse_entropy_coded_data(jpeg *z)
+{
+   int i,j,w,h;
+   int parallel = parse_restart_intervals(z);
+   if (parallel >= 0) return parallel;
+
+   reset(z);
+   w = scan_mcus_x(z);
+   h = scan_mcus_y(z);
+   for (j=0; j < h; ++j) {
+      for (i=0; i < w; ++i) {
+         if (!decode_mcu(z, i, j)) return 0;
+         // after all interleaved components, that's an interleaved MCU (in a
+         // non-interleaved scan every data block is one), so count down the
+         // restart interval
+         if (--z->todo <= 0) {
+            if (z->code_bits < 24) grow_buffer_unsafe(z);
+            // if it's NOT a restart, then just bail, so we get corrupt data
+            // rather than no data
+            if (!RESTART(z->marker)) return 1;
+            reset(z);
          }
       }
    }
@@ -1116,7 +2083,7 @@ static int process_marker(jpeg *z, int m)
                z->dequant[t][dezigzag[i]] = get8u(&z->s);
             #if STBI_SIMD
             for (i=0; i < 64; ++i)
-               z->dequant2[t][i] = dequant[t][i];
+               z->dequant2[t][i] = z->dequant[t][i];
             #endif
             L -= 65;
          }
@@ -1230,15 +2197,23 @@ static int process_frame_header(jpeg *z, int scan)
    z->img_mcu_y = (s->img_y + z->img_mcu_h-1) / z->img_mcu_h;
 
    for (i=0; i < s->img_n; ++i) {
+      int hs = h_max / z->img_comp[i].h, vs = v_max / z->img_comp[i].v, dx = 0, dy = 0;
       // number of effective pixels (e.g. for non-interleaved MCU)
       z->img_comp[i].x = (s->img_x * z->img_comp[i].h + h_max-1) / h_max;
       z->img_comp[i].y = (s->img_y * z->img_comp[i].v + v_max-1) / v_max;
+      // a scaled decode keeps the detail a subsampled component still has
+      // at the output size: half width chroma is reduced one step less across
+      while (dx < z->scale_shift && hs % (2 << dx) == 0) ++dx;
+      while (dy < z->scale_shift && vs % (2 << dy) == 0) ++dy;
+      z->img_comp[i].xshift = z->scale_shift - dx;
+      z->img_comp[i].yshift = z->scale_shift - dy;
       // to simplify generation, we'll allocate enough memory to decode
       // the bogus oversized data from using interleaved MCUs and their
       // big blocks (e.g. a 16x16 iMCU on an image of width 33); we won't
-      // discard the extra data until colorspace conversion
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      // discard the extra data until colorspace conversion; a scaled decode
+      // stores every block at its reduced size
+      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * (8 >> z->img_comp[i].xshift);
+      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * (8 >> z->img_comp[i].yshift);
       z->img_comp[i].raw_data = malloc(z->img_comp[i].w2 * z->img_comp[i].h2+15);
       if (z->img_comp[i].raw_data == NULL) {
          for(--i; i >= 0; --i) {
@@ -1378,11 +2353,174 @@ static uint8 *resample_row_generic(uint8 *out, uint8 *in_near, uint8 *in_far, in
    return out;
 }
 
+#ifdef STBI_SSE2
+// resample_row_h_2 eight input pixels at a time, each even/odd output pair is built as one 16 bit
+// lane so the store comes out interleaved
+static uint8 *resample_row_h_2_sse2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
+{
+   int i;
+   uint8 *input = in_near;
+   __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+   if (w == 1) {
+      out[0] = out[1] = input[0];
+      return out;
+   }
+
+   out[0] = input[0];
+   out[1] = div4(input[0]*3 + input[1] + 2);
+   // reads input[i-1] through input[i+8]
+   for (i=1; i + 9 <= w; i += 8) {
+      __m128i prev = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (input + i-1)), zero);
+      __m128i cur  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (input + i)), zero);
+      __m128i next = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (input + i+1)), zero);
+      __m128i n = _mm_add_epi16(_mm_add_epi16(cur, _mm_slli_epi16(cur, 1)), two);
+      __m128i even = _mm_srli_epi16(_mm_add_epi16(n, prev), 2);
+      __m128i odd  = _mm_srli_epi16(_mm_add_epi16(n, next), 2);
+      _mm_storeu_si128((__m128i *) (out + i*2), _mm_or_si128(even, _mm_slli_epi16(odd, 8)));
+   }
+   for (; i < w-1; ++i) {
+      int n = 3*input[i]+2;
+      out[i*2+0] = div4(n+input[i-1]);
+      out[i*2+1] = div4(n+input[i+1]);
+   }
+   out[i*2+0] = div4(input[w-2]*3 + input[w-1] + 2);
+   out[i*2+1] = input[w-1];
+   return out;
+}
+
+static uint8 *resample_row_hv_2_sse2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
+{
+   int i,t0,t1;
+   __m128i zero = _mm_setzero_si128(), eight = _mm_set1_epi16(8);
+   if (w == 1) {
+      out[0] = out[1] = div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   out[0] = div4(t1+2);
+   // the column sums of i-1 through i+7
+   for (i=1; i + 8 <= w; i += 8) {
+      __m128i near_prev = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (in_near + i-1)), zero);
+      __m128i far_prev  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (in_far + i-1)), zero);
+      __m128i near_cur  = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (in_near + i)), zero);
+      __m128i far_cur   = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (in_far + i)), zero);
+      __m128i prev = _mm_add_epi16(_mm_add_epi16(near_prev, _mm_slli_epi16(near_prev, 1)), far_prev);
+      __m128i cur  = _mm_add_epi16(_mm_add_epi16(near_cur, _mm_slli_epi16(near_cur, 1)), far_cur);
+      __m128i odd  = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(prev, _mm_slli_epi16(prev, 1)), _mm_add_epi16(cur, eight)), 4);
+      __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(cur, _mm_slli_epi16(cur, 1)), _mm_add_epi16(prev, eight)), 4);
+      _mm_storeu_si128((__m128i *) (out + i*2-1), _mm_or_si128(odd, _mm_slli_epi16(even, 8)));
+   }
+   t1 = 3*in_near[i-1] + in_far[i-1];
+   for (; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = div16(3*t0 + t1 + 8);
+      out[i*2  ] = div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = div4(t1+2);
+   return out;
+}
+#endif
+
+#ifdef STBI_AVX2
+// the sse2 upsamplers sixteen input pixels at a time
+STBI_AVX2_FUNCTION static uint8 *resample_row_h_2_avx2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
+{
+   int i;
+   uint8 *input = in_near;
+   __m256i two = _mm256_set1_epi16(2);
+   if (w == 1) {
+      out[0] = out[1] = input[0];
+      return out;
+   }
+
+   out[0] = input[0];
+   out[1] = div4(input[0]*3 + input[1] + 2);
+   for (i=1; i + 17 <= w; i += 16) {
+      __m256i prev = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (input + i-1)));
+      __m256i cur  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (input + i)));
+      __m256i next = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (input + i+1)));
+      __m256i n = _mm256_add_epi16(_mm256_add_epi16(cur, _mm256_slli_epi16(cur, 1)), two);
+      __m256i even = _mm256_srli_epi16(_mm256_add_epi16(n, prev), 2);
+      __m256i odd  = _mm256_srli_epi16(_mm256_add_epi16(n, next), 2);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_or_si256(even, _mm256_slli_epi16(odd, 8)));
+   }
+   for (; i < w-1; ++i) {
+      int n = 3*input[i]+2;
+      out[i*2+0] = div4(n+input[i-1]);
+      out[i*2+1] = div4(n+input[i+1]);
+   }
+   out[i*2+0] = div4(input[w-2]*3 + input[w-1] + 2);
+   out[i*2+1] = input[w-1];
+   return out;
+}
+
+STBI_AVX2_FUNCTION static uint8 *resample_row_hv_2_avx2(uint8 *out, uint8 *in_near, uint8 *in_far, int w, int hs)
+{
+   int i,t0,t1;
+   __m256i eight = _mm256_set1_epi16(8);
+   if (w == 1) {
+      out[0] = out[1] = div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   out[0] = div4(t1+2);
+   for (i=1; i + 16 <= w; i += 16) {
+      __m256i near_prev = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (in_near + i-1)));
+      __m256i far_prev  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (in_far + i-1)));
+      __m256i near_cur  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (in_near + i)));
+      __m256i far_cur   = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (in_far + i)));
+      __m256i prev = _mm256_add_epi16(_mm256_add_epi16(near_prev, _mm256_slli_epi16(near_prev, 1)), far_prev);
+      __m256i cur  = _mm256_add_epi16(_mm256_add_epi16(near_cur, _mm256_slli_epi16(near_cur, 1)), far_cur);
+      __m256i odd  = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(prev, _mm256_slli_epi16(prev, 1)), _mm256_add_epi16(cur, eight)), 4);
+      __m256i even = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(cur, _mm256_slli_epi16(cur, 1)), _mm256_add_epi16(prev, eight)), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2-1), _mm256_or_si256(odd, _mm256_slli_epi16(even, 8)));
+   }
+   t1 = 3*in_near[i-1] + in_far[i-1];
+   for (; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = div16(3*t0 + t1 + 8);
+      out[i*2  ] = div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = div4(t1+2);
+   return out;
+}
+#endif
+
+static resample_row_func resample_for(int hs, int vs, int level)
+{
+   (void) level;
+   if (hs == 1 && vs == 1) return resample_row_1;
+   if (hs == 1 && vs == 2) return resample_row_v_2;
+   if (hs == 2 && vs == 1) {
+      #ifdef STBI_AVX2
+      if (level >= STBI_simd_avx2) return resample_row_h_2_avx2;
+      #endif
+      #ifdef STBI_SSE2
+      if (level >= STBI_simd_sse2) return resample_row_h_2_sse2;
+      #endif
+      return resample_row_h_2;
+   }
+   if (hs == 2 && vs == 2) {
+      #ifdef STBI_AVX2
+      if (level >= STBI_simd_avx2) return resample_row_hv_2_avx2;
+      #endif
+      #ifdef STBI_SSE2
+      if (level >= STBI_simd_sse2) return resample_row_hv_2_sse2;
+      #endif
+      return resample_row_hv_2;
+   }
+   return resample_row_generic;
+}
+
 #define float2fixed(x)  ((int) ((x) * 65536 + 0.5))
 
 // 0.38 seconds on 3*anemones.jpg   (0.25 with processor = Pro)
 // VC6 without processor=Pro is generating multiple LEAs per multiply!
-static void YCbCr_to_RGB_row(uint8 *out, uint8 *y, uint8 *pcb, uint8 *pcr, int count, int step)
+static void YCbCr_to_RGB_row(uint8 *out, uint8 const *y, uint8 const *pcb, uint8 const *pcr, int count, int step)
 {
    int i;
    for (i=0; i < count; ++i) {
@@ -1402,18 +2540,168 @@ static void YCbCr_to_RGB_row(uint8 *out, uint8 *y, uint8 *pcb, uint8 *pcr, int c
       out[0] = (uint8)r;
       out[1] = (uint8)g;
       out[2] = (uint8)b;
-      out[3] = 255;
+      // only inside the pixel, a row can end where another thread's begins
+      if (step == 4) out[3] = 255;
       out += step;
    }
 }
 
+#ifdef STBI_SSE2
+// YCbCr_to_RGB_row with each factor split into whole multiples of 1<<16, which carry y, cr and
+// cb through the shift untouched, and a remainder small enough for pmaddwd. (y<<16) + 32768 +
+// cr*f >> 16 is then y + k*cr + (cr*(f - k<<16) + 32768 >> 16), exactly what the scalar gives.
+#define YCC_R_CR   (float2fixed(1.40200f) - 65536)
+#define YCC_G_CR   (65536 - float2fixed(0.71414f))
+#define YCC_G_CB   (-float2fixed(0.34414f))
+#define YCC_B_CB   (float2fixed(1.77200f) - 131072)
+
+#define YCC_PAIR(cr,cb)   _mm_setr_epi16((short) (cr), (short) (cb), (short) (cr), (short) (cb), \
+                                         (short) (cr), (short) (cb), (short) (cr), (short) (cb))
+
+// the rounded remainder term of eight pixels from their interleaved cr,cb pairs
+static STBI_SIMD_INLINE __m128i ycc_term_sse2(__m128i lo, __m128i hi, __m128i factors)
+{
+   __m128i half = _mm_set1_epi32(32768);
+   return _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo, factors), half), 16),
+                          _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi, factors), half), 16));
+}
+
+// eight pixels, returns R0 B0 .. R7 B7 as 16 bytes in rb and G0 255 .. G7 255 in ga
+static STBI_SIMD_INLINE void ycc_8_sse2(__m128i y, __m128i cb, __m128i cr, __m128i *rb, __m128i *ga)
+{
+   __m128i lo = _mm_unpacklo_epi16(cr, cb), hi = _mm_unpackhi_epi16(cr, cb);
+   __m128i r = _mm_add_epi16(_mm_add_epi16(y, cr), ycc_term_sse2(lo, hi, YCC_PAIR(YCC_R_CR, 0)));
+   __m128i g = _mm_add_epi16(_mm_sub_epi16(y, cr), ycc_term_sse2(lo, hi, YCC_PAIR(YCC_G_CR, YCC_G_CB)));
+   __m128i b = _mm_add_epi16(_mm_add_epi16(y, _mm_slli_epi16(cb, 1)), ycc_term_sse2(lo, hi, YCC_PAIR(0, YCC_B_CB)));
+   // packus clamps to 0..255 the same as the scalar tests
+   __m128i packed_rb = _mm_packus_epi16(r, b), packed_ga = _mm_packus_epi16(g, _mm_set1_epi16(255));
+   *rb = _mm_unpacklo_epi8(packed_rb, packed_ga);
+   *ga = _mm_unpackhi_epi8(packed_rb, packed_ga);
+}
+
+static STBI_SIMD_INLINE void store32(uint8 *out, __m128i v)
+{
+   int bits = _mm_cvtsi128_si32(v);
+   memcpy(out, &bits, 4);
+}
+
+static void YCbCr_to_RGB_sse2(uint8 *out, uint8 const *y, uint8 const *pcb, uint8 const *pcr, int count, int step)
+{
+   __m128i zero = _mm_setzero_si128(), bias = _mm_set1_epi16(128);
+   // with a step of 3 every pixel is stored as 4 bytes and the last one's spare byte lands on
+   // the pixel after it, which the scalar loop writes afterwards
+   int i, simd_count = step == 4 ? count : count - 1;
+   for (i=0; i + 8 <= simd_count; i += 8) {
+      __m128i rg, ba, p0, p1;
+      __m128i yw = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (y + i)), zero);
+      __m128i cb = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (pcb + i)), zero), bias);
+      __m128i cr = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *) (pcr + i)), zero), bias);
+      ycc_8_sse2(yw, cb, cr, &rg, &ba);
+      // rg is R G pairs, ba B 255 pairs, one more interleave gives RGBA pixels
+      p0 = _mm_unpacklo_epi16(rg, ba);
+      p1 = _mm_unpackhi_epi16(rg, ba);
+      if (step == 4) {
+         _mm_storeu_si128((__m128i *) out, p0);
+         _mm_storeu_si128((__m128i *) (out + 16), p1);
+      } else {
+         store32(out,      p0);
+         store32(out + 3,  _mm_srli_si128(p0, 4));
+         store32(out + 6,  _mm_srli_si128(p0, 8));
+         store32(out + 9,  _mm_srli_si128(p0, 12));
+         store32(out + 12, p1);
+         store32(out + 15, _mm_srli_si128(p1, 4));
+         store32(out + 18, _mm_srli_si128(p1, 8));
+         store32(out + 21, _mm_srli_si128(p1, 12));
+      }
+      out += 8*step;
+   }
+   YCbCr_to_RGB_row(out, y + i, pcb + i, pcr + i, count - i, step);
+}
+#endif
+
+#ifdef STBI_AVX2
+#define YCC_PAIR256(cr,cb)   _mm256_set1_epi32((int) (((unsigned int) (cb) << 16) | ((unsigned int) (cr) & 0xffff)))
+
+STBI_AVX2_FUNCTION static STBI_SIMD_INLINE __m256i ycc_term_avx2(__m256i lo, __m256i hi, __m256i factors)
+{
+   __m256i half = _mm256_set1_epi32(32768);
+   return _mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(lo, factors), half), 16),
+                             _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(hi, factors), half), 16));
+}
+
+// sixteen pixels at a time. The in-lane unpacks and packs keep pixels 0..7 in the low half and
+// 8..15 in the high one all the way to the RGBA interleave, one lane swap puts them in order.
+STBI_AVX2_FUNCTION static void YCbCr_to_RGB_avx2(uint8 *out, uint8 const *y, uint8 const *pcb, uint8 const *pcr, int count, int step)
+{
+   __m256i bias = _mm256_set1_epi16(128);
+   __m256i rgb = _mm256_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1, 0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+   // with a step of 3 each 16 byte store carries 12 bytes, the last spills 4 bytes onto the two
+   // pixels after it
+   int i, simd_count = step == 4 ? count : count - 2;
+   for (i=0; i + 16 <= simd_count; i += 16) {
+      __m256i yw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (y + i)));
+      __m256i cb = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (pcb + i))), bias);
+      __m256i cr = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *) (pcr + i))), bias);
+      __m256i lo = _mm256_unpacklo_epi16(cr, cb), hi = _mm256_unpackhi_epi16(cr, cb);
+      __m256i r = _mm256_add_epi16(_mm256_add_epi16(yw, cr), ycc_term_avx2(lo, hi, YCC_PAIR256(YCC_R_CR, 0)));
+      __m256i g = _mm256_add_epi16(_mm256_sub_epi16(yw, cr), ycc_term_avx2(lo, hi, YCC_PAIR256(YCC_G_CR, YCC_G_CB)));
+      __m256i b = _mm256_add_epi16(_mm256_add_epi16(yw, _mm256_slli_epi16(cb, 1)), ycc_term_avx2(lo, hi, YCC_PAIR256(0, YCC_B_CB)));
+      __m256i packed_rb = _mm256_packus_epi16(r, b), packed_ga = _mm256_packus_epi16(g, _mm256_set1_epi16(255));
+      __m256i rg = _mm256_unpacklo_epi8(packed_rb, packed_ga), ba = _mm256_unpackhi_epi8(packed_rb, packed_ga);
+      __m256i p0 = _mm256_unpacklo_epi16(rg, ba), p1 = _mm256_unpackhi_epi16(rg, ba);
+      __m256i first = _mm256_permute2x128_si256(p0, p1, 0x20), second = _mm256_permute2x128_si256(p0, p1, 0x31);
+      if (step == 4) {
+         _mm256_storeu_si256((__m256i *) out, first);
+         _mm256_storeu_si256((__m256i *) (out + 32), second);
+      } else {
+         first = _mm256_shuffle_epi8(first, rgb);
+         second = _mm256_shuffle_epi8(second, rgb);
+         _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(first));
+         _mm_storeu_si128((__m128i *) (out + 12), _mm256_extracti128_si256(first, 1));
+         _mm_storeu_si128((__m128i *) (out + 24), _mm256_castsi256_si128(second));
+         _mm_storeu_si128((__m128i *) (out + 36), _mm256_extracti128_si256(second, 1));
+      }
+      out += 16*step;
+   }
+   YCbCr_to_RGB_row(out, y + i, pcb + i, pcr + i, count - i, step);
+}
+#endif
+
 #if STBI_SIMD
-static stbi_YCbCr_to_RGB_run stbi_YCbCr_installed = YCbCr_to_RGB_row;
+static stbi_YCbCr_to_RGB_run YCbCr_for_level(int level)
+{
+   if (level > stbi_simd_support())
+      level = stbi_simd_support();
+#ifdef STBI_AVX2
+   if (level == STBI_simd_avx2) return YCbCr_to_RGB_avx2;
+#endif
+#ifdef STBI_SSE2
+   if (level >= STBI_simd_sse2) return YCbCr_to_RGB_sse2;
+#endif
+   return YCbCr_to_RGB_row;
+}
+
+// NULL until installed, like stbi_idct_installed
+static stbi_YCbCr_to_RGB_run stbi_YCbCr_installed = NULL;
+
+static stbi_YCbCr_to_RGB_run YCbCr_installed(void)
+{
+   return stbi_YCbCr_installed ? stbi_YCbCr_installed : YCbCr_for_level(stbi_simd_support());
+}
 
 void stbi_install_YCbCr_to_RGB(stbi_YCbCr_to_RGB_run func)
 {
    stbi_YCbCr_installed = func;
 }
+
+void stbi_simd_install(int level)
+{
+   if (level > stbi_simd_support())
+      level = stbi_simd_support();
+   stbi_idct_installed = idct_for_level(level);
+   stbi_YCbCr_installed = YCbCr_for_level(level);
+   stbi_kernel_level = level;
+}
 #endif
 
 
@@ -1443,16 +2731,130 @@ typedef struct
    int ypos;    // which pre-expansion row we're on
 } stbi_resample;
 
-static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
+// move a resampler from the first output row to row j, as if it had stepped
+// through every row before it
+static void resample_seek(stbi_resample *r, int comp_y, int w2, int j)
+{
+   uint8 *data = r->line1;
+   int steps = (r->vs >> 1) + j;
+   int wraps = steps / r->vs;
+   r->ystep = steps % r->vs;
+   r->ypos  = wraps;
+   if (wraps > 0) {
+      r->line0 = data + w2 * (wraps-1 < comp_y-1 ? wraps-1 : comp_y-1);
+      r->line1 = data + w2 * (wraps < comp_y-1 ? wraps : comp_y-1);
+   }
+}
+
+// rows of the output are resampled and color converted in bands that run on
+// separate threads, each with its own resamplers and line buffers
+typedef struct
+{
+   jpeg *z;
+   stbi_resample *res_comp;
+   uint8 *output;
+   int n, decode_n, bands;
+} stbi_resample_bands;
+
+// resample and color-convert output rows [j0,j1)
+static void resample_rows(jpeg *z, stbi_resample *res_comp, uint8 **linebuf, uint8 *output, int n, int decode_n, uint j0, uint j1)
+{
+   int k;
+   uint i,j;
+   uint8 *coutput[4];
+   for (j=j0; j < j1; ++j) {
+      uint8 *out = output + n * z->s.img_x * j;
+      for (k=0; k < decode_n; ++k) {
+         stbi_resample *r = &res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         coutput[k] = r->resample(linebuf[k],
+                                  y_bot ? r->line1 : r->line0,
+                                  y_bot ? r->line0 : r->line1,
+                                  r->w_lores, r->hs);
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+      if (n >= 3) {
+         uint8 *y = coutput[0];
+         if (z->s.img_n == 3) {
+            #if STBI_SIMD
+            z->YCbCr(out, y, coutput[1], coutput[2], z->s.img_x, n);
+            #else
+            YCbCr_to_RGB_row(out, y, coutput[1], coutput[2], z->s.img_x, n);
+            #endif
+         } else
+            for (i=0; i < z->s.img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               if (n == 4) out[3] = 255;
+               out += n;
+            }
+      } else {
+         uint8 *y = coutput[0];
+         if (n == 1)
+            for (i=0; i < z->s.img_x; ++i) out[i] = y[i];
+         else
+            for (i=0; i < z->s.img_x; ++i) *out++ = y[i], *out++ = 255;
+      }
+   }
+}
+
+static void resample_band_task(void *context, int band)
+{
+   stbi_resample_bands *b = (stbi_resample_bands *) context;
+   jpeg *z = b->z;
+   stbi_resample res_comp[4];
+   uint8 *linebuf[4];
+   uint j0 = z->s.img_y * band / b->bands;
+   uint j1 = z->s.img_y * (band+1) / b->bands;
+   int k;
+   for (k=0; k < b->decode_n; ++k) {
+      res_comp[k] = b->res_comp[k];
+      resample_seek(&res_comp[k], z->img_comp[k].y, z->img_comp[k].w2, j0);
+      linebuf[k] = z->img_comp[k].linebuf + band * (z->s.img_x + 3);
+   }
+   resample_rows(z, res_comp, linebuf, b->output, b->n, b->decode_n, j0, j1);
+}
+
+// output pixels a band should have at least to be worth a thread
+#define STBI_BAND_PIXELS  65536
+
+static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int req_comp, int scale_shift)
 {
    int n, decode_n;
    // validate req_comp
    if (req_comp < 0 || req_comp > 4) return epuc("bad req_comp", "Internal error");
    z->s.img_n = 0;
+   z->scale_shift = scale_shift;
+   #if STBI_SIMD
+   // read the installed kernels once, the restart interval and band workers
+   // only ever see these copies
+   z->idct = idct_installed();
+   z->YCbCr = YCbCr_installed();
+   z->kernel_level = kernel_level();
+   #else
+   z->kernel_level = 0;
+   #endif
 
    // load a jpeg image from whichever source
    if (!decode_jpeg_image(z)) { cleanup_jpeg(z); return NULL; }
 
+   // the planes hold a reduced image, which rounds its size up like the planes did
+   if (scale_shift) {
+      int k, xs, ys;
+      z->s.img_x = (z->s.img_x + (1 << scale_shift)-1) >> scale_shift;
+      z->s.img_y = (z->s.img_y + (1 << scale_shift)-1) >> scale_shift;
+      for (k=0; k < z->s.img_n; ++k) {
+         xs = z->img_comp[k].xshift;
+         ys = z->img_comp[k].yshift;
+         z->img_comp[k].x = (z->img_comp[k].x + (1 << xs)-1) >> xs;
+         z->img_comp[k].y = (z->img_comp[k].y + (1 << ys)-1) >> ys;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s.img_n;
 
@@ -1464,82 +2866,52 @@ static uint8 *load_jpeg_image(jpeg *z, int *out_x, int *out_y, int *comp, int re
    // resample and color-convert
    {
       int k;
-      uint i,j;
-      uint8 *output;
-      uint8 *coutput[4];
-
+      stbi_resample_bands b;
       stbi_resample res_comp[4];
 
+      b.bands = (int) (z->s.img_x * z->s.img_y / STBI_BAND_PIXELS);
+      if (b.bands > tasks_wanted()) b.bands = tasks_wanted();
+      if (b.bands > (int) z->s.img_y) b.bands = z->s.img_y;
+      if (b.bands < 1) b.bands = 1;
+
       for (k=0; k < decode_n; ++k) {
          stbi_resample *r = &res_comp[k];
 
-         // allocate line buffer big enough for upsampling off the edges
-         // with upsample factor of 4
-         z->img_comp[k].linebuf = (uint8 *) malloc(z->s.img_x + 3);
+         // allocate line buffers big enough for upsampling off the edges
+         // with upsample factor of 4, one for every band
+         z->img_comp[k].linebuf = (uint8 *) malloc((z->s.img_x + 3) * b.bands);
          if (!z->img_comp[k].linebuf) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
 
-         r->hs      = z->img_h_max / z->img_comp[k].h;
-         r->vs      = z->img_v_max / z->img_comp[k].v;
+         // a component reduced less than the output is that much less expanded
+         r->hs      = (z->img_h_max / z->img_comp[k].h) >> (z->scale_shift - z->img_comp[k].xshift);
+         r->vs      = (z->img_v_max / z->img_comp[k].v) >> (z->scale_shift - z->img_comp[k].yshift);
          r->ystep   = r->vs >> 1;
          r->w_lores = (z->s.img_x + r->hs-1) / r->hs;
          r->ypos    = 0;
          r->line0   = r->line1 = z->img_comp[k].data;
 
-         if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = resample_row_h_2;
-         else if (r->hs == 2 && r->vs == 2) r->resample = resample_row_hv_2;
-         else                               r->resample = resample_row_generic;
+         r->resample = resample_for(r->hs, r->vs, z->kernel_level);
       }
 
       // can't error after this so, this is safe
-      output = (uint8 *) malloc(n * z->s.img_x * z->s.img_y + 1);
-      if (!output) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
+      b.output = (uint8 *) malloc(n * z->s.img_x * z->s.img_y + 1);
+      if (!b.output) { cleanup_jpeg(z); return epuc("outofmem", "Out of memory"); }
 
       // now go ahead and resample
-      for (j=0; j < z->s.img_y; ++j) {
-         uint8 *out = output + n * z->s.img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi_resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            uint8 *y = coutput[0];
-            if (z->s.img_n == 3) {
-               #if STBI_SIMD
-               stbi_YCbCr_installed(out, y, coutput[1], coutput[2], z->s.img_x, n);
-               #else
-               YCbCr_to_RGB_row(out, y, coutput[1], coutput[2], z->s.img_x, n);
-               #endif
-            } else
-               for (i=0; i < z->s.img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            uint8 *y = coutput[0];
-            if (n == 1)
-               for (i=0; i < z->s.img_x; ++i) out[i] = y[i];
-            else
-               for (i=0; i < z->s.img_x; ++i) *out++ = y[i], *out++ = 255;
-         }
-      }
+      b.z = z;
+      b.res_comp = res_comp;
+      b.n = n;
+      b.decode_n = decode_n;
+      if (b.bands > 1)
+         run_tasks(resample_band_task, &b, b.bands);
+      else
+         resample_band_task(&b, 0);
+
       cleanup_jpeg(z);
       *out_x = z->s.img_x;
       *out_y = z->s.img_y;
       if (comp) *comp  = z->s.img_n; // report original components, not output
-      return output;
+      return b.output;
    }
 }
 
@@ -1548,16 +2920,16 @@ unsigned char *stbi_jpeg_load_from_file(FILE *f, int *x, int *y, int *comp, int
 {
    jpeg j;
    start_file(&j.s, f);
-   return load_jpeg_image(&j, x,y,comp,req_comp);
+   return load_jpeg_image(&j, x,y,comp,req_comp, 0);
 }
 
 unsigned char *stbi_jpeg_load(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
    unsigned char *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_jpeg_load_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_bytes b;
+   if (!open_file_bytes(&b, filename)) return NULL;
+   data = stbi_jpeg_load_from_memory(b.data, b.len, x,y,comp,req_comp);
+   close_file_bytes(&b);
    return data;
 }
 #endif
@@ -1566,8 +2938,29 @@ unsigned char *stbi_jpeg_load_from_memory(stbi_uc const *buffer, int len, int *x
 {
    jpeg j;
    start_mem(&j.s, buffer,len);
-   return load_jpeg_image(&j, x,y,comp,req_comp);
+   return load_jpeg_image(&j, x,y,comp,req_comp, 0);
+}
+
+unsigned char *stbi_jpeg_load_from_memory_scaled(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, int scale)
+{
+   jpeg j;
+   int shift = scale_to_shift(scale);
+   if (shift < 0) return epuc("bad scale", "Scale must be 1, 2, 4 or 8");
+   start_mem(&j.s, buffer,len);
+   return load_jpeg_image(&j, x,y,comp,req_comp, shift);
+}
+
+#ifndef STBI_NO_STDIO
+unsigned char *stbi_jpeg_load_scaled(char const *filename, int *x, int *y, int *comp, int req_comp, int scale)
+{
+   unsigned char *data;
+   stbi_file_bytes b;
+   if (!open_file_bytes(&b, filename)) return NULL;
+   data = stbi_jpeg_load_from_memory_scaled(b.data, b.len, x,y,comp,req_comp,scale);
+   close_file_bytes(&b);
+   return data;
 }
+#endif
 
 #ifndef STBI_NO_STDIO
 int stbi_jpeg_test_file(FILE *f)
@@ -2300,6 +3693,7 @@ static int parse_png_file(png *z, int scan, int req_comp)
             else
             #endif
             {
+               if ((uint32) (s->img_buffer_end - s->img_buffer) < c.length) return e("outofdata","Corrupt PNG");
                memcpy(z->idata+ioff, s->img_buffer, c.length);
                s->img_buffer += c.length;
             }
@@ -2391,10 +3785,10 @@ unsigned char *stbi_png_load_from_file(FILE *f, int *x, int *y, int *comp, int r
 unsigned char *stbi_png_load(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
    unsigned char *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_png_load_from_file(f,x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_bytes b;
+   if (!open_file_bytes(&b, filename)) return NULL;
+   data = stbi_png_load_from_memory(b.data, b.len, x,y,comp,req_comp);
+   close_file_bytes(&b);
    return data;
 }
 #endif
@@ -2706,10 +4100,10 @@ static stbi_uc *bmp_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 stbi_uc *stbi_bmp_load             (char const *filename,           int *x, int *y, int *comp, int req_comp)
 {
    stbi_uc *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_bmp_load_from_file(f, x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_bytes b;
+   if (!open_file_bytes(&b, filename)) return NULL;
+   data = stbi_bmp_load_from_memory(b.data, b.len, x,y,comp,req_comp);
+   close_file_bytes(&b);
    return data;
 }
 
@@ -2992,10 +4386,10 @@ static stbi_uc *tga_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 stbi_uc *stbi_tga_load             (char const *filename,           int *x, int *y, int *comp, int req_comp)
 {
    stbi_uc *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_tga_load_from_file(f, x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_bytes b;
+   if (!open_file_bytes(&b, filename)) return NULL;
+   data = stbi_tga_load_from_memory(b.data, b.len, x,y,comp,req_comp);
+   close_file_bytes(&b);
    return data;
 }
 
@@ -3206,10 +4600,10 @@ static stbi_uc *psd_load(stbi *s, int *x, int *y, int *comp, int req_comp)
 stbi_uc *stbi_psd_load(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
    stbi_uc *data;
-   FILE *f = fopen(filename, "rb");
-   if (!f) return NULL;
-   data = stbi_psd_load_from_file(f, x,y,comp,req_comp);
-   fclose(f);
+   stbi_file_bytes b;
+   if (!open_file_bytes(&b, filename)) return NULL;
+   data = stbi_psd_load_from_memory(b.data, b.len, x,y,comp,req_comp);
+   close_file_bytes(&b);
    return data;
 }
 
@@ -3545,11 +4939,11 @@ stbi_uc *stbi_hdr_load_rgbe_file(FILE *f, int *x, int *y, int *comp, int req_com
 
 stbi_uc *stbi_hdr_load_rgbe        (char const *filename,           int *x, int *y, int *comp, int req_comp)
 {
-   FILE *f = fopen(filename, "rb");
+   stbi_file_bytes b;
    unsigned char *result;
-   if (!f) return epuc("can't fopen", "Unable to open file");
-   result = stbi_hdr_load_rgbe_file(f,x,y,comp,req_comp);
-   fclose(f);
+   if (!open_file_bytes(&b, filename)) return NULL;
+   result = stbi_hdr_load_rgbe_memory(b.data, b.len, x,y,comp,req_comp);
+   close_file_bytes(&b);
    return result;
 }
 #endif